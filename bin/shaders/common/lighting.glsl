@@ -0,0 +1,83 @@
+// Light types and their shading, shared by the lit fragment shaders. Included with #include, after #version.
+// Variants: define PHONG for Phong specular highlights instead of Blinn-Phong.
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+struct PointLight {
+    vec3 position;
+    float constant;
+    float linear;
+    float quadratic;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+struct FlashLight {
+    float cutOff;
+    float outerCutOff;
+    float constant;
+    float linear;
+    float quadratic;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// what the lights shade, sampled once per fragment by the including shader. Vectors are in view space.
+struct Surface {
+    vec3 normal;
+    vec3 position;
+    vec3 viewDir;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+uniform mat4 view;
+
+float specularTerm(Surface surface, vec3 lightDir) {
+#ifdef PHONG
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    return pow(max(dot(surface.viewDir, reflectDir), 0.0), surface.shininess);
+#else
+    vec3 halfwayDir = normalize(lightDir + surface.viewDir);
+    return pow(max(dot(surface.normal, halfwayDir), 0.0), surface.shininess);
+#endif
+}
+
+vec3 shade(Surface surface, vec3 lightDir, vec3 ambient, vec3 diffuse, vec3 specular) {
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    float spec = specularTerm(surface, lightDir);
+    return ambient * surface.diffuse + diff * diffuse * surface.diffuse + spec * specular * surface.specular;
+}
+
+float attenuation(float constant, float linear, float quadratic, float dist) {
+    return 1.0 / (constant + linear * dist + quadratic * dist * dist);
+}
+
+vec3 calcDirLight(DirLight light, Surface surface) {
+    vec3 lightDir = normalize(vec3(view * vec4(-light.direction, 0.0)));
+    return shade(surface, lightDir, light.ambient, light.diffuse, light.specular);
+}
+
+vec3 calcPointLight(PointLight light, Surface surface) {
+    vec3 viewLightPos = vec3(view * vec4(light.position, 1.0));
+    vec3 lightDir = normalize(viewLightPos - surface.position);
+    float dist = length(viewLightPos - surface.position);
+    return shade(surface, lightDir, light.ambient, light.diffuse, light.specular)
+         * attenuation(light.constant, light.linear, light.quadratic, dist);
+}
+
+// a spotlight at the camera, looking along -z
+vec3 calcFlashLight(FlashLight light, Surface surface) {
+    vec3 lightDir = normalize(-surface.position);
+    float theta = dot(lightDir, vec3(0.0, 0.0, 1.0));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    float dist = length(surface.position);
+    return shade(surface, lightDir, light.ambient, light.diffuse, light.specular)
+         * intensity * attenuation(light.constant, light.linear, light.quadratic, dist);
+}
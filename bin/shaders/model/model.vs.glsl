@@ -2,10 +2,12 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in uint aLayer; // material layer when the textures are arrays
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
+flat out uint Layer;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -16,5 +18,6 @@ void main() {
     FragPos = vec3(view * model * vec4(aPos, 1.0));
     Normal = normalMat * aNormal;
     TexCoords = aTexCoords;
+    Layer = aLayer;
     gl_Position = projection * vec4(FragPos, 1.0);
 }
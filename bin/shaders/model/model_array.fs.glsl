@@ -0,0 +1,32 @@
+#version 410 core
+#include "../common/lighting.glsl"
+
+struct Material {
+    sampler2DArray texture_diffuse1; // one layer per material, Layer picks it
+    sampler2DArray texture_specular1;
+    float shininess;
+};
+
+uniform PointLight pointLight;
+uniform DirLight dirLight;
+uniform Material material;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoords;
+flat in uint Layer;
+
+out vec4 fragColor;
+
+void main() {
+    Surface surface;
+    surface.normal = normalize(Normal);
+    surface.position = FragPos;
+    surface.viewDir = normalize(-FragPos);
+    surface.diffuse = vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layer)));
+    surface.specular = vec3(texture(material.texture_specular1, vec3(TexCoords, Layer)));
+    surface.shininess = material.shininess;
+    vec3 result = calcPointLight(pointLight, surface);
+    result += calcDirLight(dirLight, surface);
+    fragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 410 core
+layout (location = 0) in vec4 aPos; // normalized to the model bounds, w is the bitangent sign
+layout (location = 1) in vec2 aNormal; // octahedral encoded
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec2 aTangent; // octahedral encoded
+layout (location = 7) in uint aLayer; // material layer when the textures are arrays
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+flat out uint Layer;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normalMat;
+uniform vec3 aabbMin;
+uniform vec3 aabbExtent;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = aabbMin + aPos.xyz * aabbExtent;
+    FragPos = vec3(view * model * vec4(position, 1.0));
+    Normal = normalMat * octDecode(aNormal);
+    TexCoords = aTexCoords;
+    Layer = aLayer;
+    gl_Position = projection * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,30 @@
+#version 410 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uvec4 aBoneIds;
+layout (location = 6) in vec4 aBoneWeights; // sum to 1, or all 0 for rigid vertices
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normalMat;
+
+layout (std140) uniform BonePalette {
+    mat4 bones[256]; // Animator::MAX_BONES
+};
+
+void main() {
+    mat4 skin = bones[aBoneIds.x] * aBoneWeights.x + bones[aBoneIds.y] * aBoneWeights.y
+              + bones[aBoneIds.z] * aBoneWeights.z + bones[aBoneIds.w] * aBoneWeights.w;
+    if (aBoneWeights == vec4(0.0))
+        skin = mat4(1.0);
+    FragPos = vec3(view * model * skin * vec4(aPos, 1.0));
+    Normal = normalMat * mat3(skin) * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,235 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define SKINNING_AVX2 1
+#endif
+#include "parallel.h"
+#include "transform.h"
+
+struct Bone {
+    std::string name;
+    int node;         // TransformHierarchy node that moves the bone
+    glm::mat4 offset; // mesh space to bone space in the bind pose
+};
+
+// one animated node, its keys are ranges of the clip's key arrays
+struct AnimationChannel {
+    int node;
+    unsigned int firstPosition, positionCount;
+    unsigned int firstRotation, rotationCount;
+    unsigned int firstScale, scaleCount;
+};
+
+// keyframes of every channel of a clip, kept as separate time and value arrays. Times are in seconds.
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f;
+    std::vector<AnimationChannel> channels;
+    std::vector<float> positionTimes, rotationTimes, scaleTimes;
+    std::vector<glm::vec3> positions, scales;
+    std::vector<glm::quat> rotations;
+
+    // sets the local transforms of the animated nodes of pose to the clip at time
+    void sample(float time, TransformHierarchy &pose) const
+    {
+        for (const AnimationChannel &channel : channels) {
+            if (channel.positionCount)
+                pose.setPosition(channel.node, interpolate(&positionTimes[channel.firstPosition], &positions[channel.firstPosition],
+                                                           channel.positionCount, time));
+            if (channel.rotationCount)
+                pose.setRotation(channel.node, interpolate(&rotationTimes[channel.firstRotation], &rotations[channel.firstRotation],
+                                                           channel.rotationCount, time));
+            if (channel.scaleCount)
+                pose.setScale(channel.node, interpolate(&scaleTimes[channel.firstScale], &scales[channel.firstScale],
+                                                        channel.scaleCount, time));
+        }
+    }
+
+private:
+    static glm::vec3 blend(const glm::vec3 &a, const glm::vec3 &b, float f) { return a + (b - a) * f; }
+    static glm::quat blend(const glm::quat &a, const glm::quat &b, float f) { return glm::slerp(a, b, f); }
+
+    template<typename T>
+    static T interpolate(const float *times, const T *values, unsigned int count, float time)
+    {
+        if (count == 1 || time <= times[0]) return values[0];
+        if (time >= times[count - 1]) return values[count - 1];
+        unsigned int next = std::upper_bound(times, times + count, time) - times;
+        float f = (time - times[next - 1]) / (times[next] - times[next - 1]);
+        return blend(values[next - 1], values[next], f);
+    }
+};
+
+// playback state and pose of one animated character
+struct AnimationState {
+    TransformHierarchy pose;        // copy of the model's transforms, node 0 places the character
+    int clip = -1;                  // index into the model's clips, -1 holds the bind pose
+    float time = 0.0f;              // seconds into the clip
+    float speed = 1.0f;
+    bool loop = true;
+    int skinNode = 0;               // node the skinned meshes hang from, their vertices are relative to it
+    std::vector<glm::mat4> palette; // skinning matrix per bone
+};
+
+class Animator {
+public:
+    constexpr static unsigned int MAX_BONES = 256;     // bone ids are bytes, and 256 mat4 fill the minimum uniform block size
+    constexpr static unsigned int MAX_INFLUENCES = 4;
+    constexpr static size_t UPDATE_GRAIN = 16;         // characters per task
+
+    // advances every state by deltaTime, samples its clip into its pose and rebuilds its palette on the worker threads
+    static void update(std::vector<AnimationState> &states, const std::vector<AnimationClip> &clips,
+                       const std::vector<Bone> &bones, float deltaTime)
+    {
+        parallelFor(0, states.size(), UPDATE_GRAIN, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                AnimationState &state = states[i];
+                if (state.clip >= 0 && state.clip < int(clips.size())) {
+                    const AnimationClip &clip = clips[state.clip];
+                    state.time += deltaTime * state.speed;
+                    if (state.loop && clip.duration > 0.0f)
+                        state.time -= clip.duration * std::floor(state.time / clip.duration);
+                    else
+                        state.time = std::min(state.time, clip.duration);
+                    clip.sample(state.time, state.pose);
+                }
+                state.pose.update();
+                computePalette(state.pose, bones, state.skinNode, state.palette);
+            }
+        });
+    }
+
+    // palette[b] takes a vertex from skin node space through the bind pose of bone b to where the pose puts it,
+    // back in skin node space, so skinned meshes are drawn with the skin node's world matrix
+    static void computePalette(const TransformHierarchy &pose, const std::vector<Bone> &bones, int skinNode,
+                               std::vector<glm::mat4> &palette)
+    {
+        palette.resize(bones.size());
+        const glm::mat4 &toSkin = pose.inverseWorld(skinNode);
+        for (size_t b = 0; b < bones.size(); b++)
+            palette[b] = bones[b].node >= 0 ? toSkin * pose.world(bones[b].node) * bones[b].offset : glm::mat4(1.0f);
+    }
+
+    // keeps the MAX_INFLUENCES largest of count weights and quantizes them to bytes that sum to 255
+    static void packWeights(const unsigned int *ids, const float *weights, unsigned int count,
+                            std::uint8_t packedIds[MAX_INFLUENCES], std::uint8_t packedWeights[MAX_INFLUENCES])
+    {
+        unsigned int order[MAX_INFLUENCES];
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int slot = kept < MAX_INFLUENCES ? kept++ : MAX_INFLUENCES;
+            if (slot == MAX_INFLUENCES) { // replace the smallest if this one is larger
+                slot = 0;
+                for (unsigned int k = 1; k < MAX_INFLUENCES; k++)
+                    if (weights[order[k]] < weights[order[slot]]) slot = k;
+                if (weights[i] <= weights[order[slot]]) continue;
+            }
+            order[slot] = i;
+        }
+        float total = 0.0f;
+        for (unsigned int k = 0; k < kept; k++)
+            total += weights[order[k]];
+        int remaining = 255;
+        for (unsigned int k = 0; k < MAX_INFLUENCES; k++) {
+            packedIds[k] = k < kept ? std::uint8_t(ids[order[k]]) : 0;
+            int weight = k < kept && total > 0.0f ? int(std::round(weights[order[k]] / total * 255.0f)) : 0;
+            weight = std::min(weight, remaining);
+            if (k + 1 == kept && total > 0.0f)
+                weight = remaining; // rounding leftovers go to the last influence
+            packedWeights[k] = std::uint8_t(weight);
+            remaining -= weight;
+        }
+    }
+
+    // CPU skinning of count interleaved vertices. The position and normal are three floats at the start of the
+    // vertex and at normalOffset, the bone ids and weights MAX_INFLUENCES bytes each at boneOffset.
+    // Vertices without weights are copied. Uses AVX2 and FMA when compiled for them.
+    static void skin(const void *vertices, size_t count, size_t stride, size_t normalOffset, size_t boneOffset,
+                     const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals)
+    {
+#ifdef SKINNING_AVX2
+        skinAvx2(vertices, count, stride, normalOffset, boneOffset, palette, positions, normals);
+#else
+        skinScalar(vertices, count, stride, normalOffset, boneOffset, palette, positions, normals);
+#endif
+    }
+
+    static void skinScalar(const void *vertices, size_t count, size_t stride, size_t normalOffset, size_t boneOffset,
+                           const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals)
+    {
+        const char *data = static_cast<const char *>(vertices);
+        for (size_t v = 0; v < count; v++, data += stride) {
+            const float *position = reinterpret_cast<const float *>(data);
+            const float *normal = reinterpret_cast<const float *>(data + normalOffset);
+            const std::uint8_t *ids = reinterpret_cast<const std::uint8_t *>(data + boneOffset);
+            const std::uint8_t *weights = ids + MAX_INFLUENCES;
+            if (!(weights[0] | weights[1] | weights[2] | weights[3])) {
+                positions[v] = glm::vec3(position[0], position[1], position[2]);
+                normals[v] = glm::vec3(normal[0], normal[1], normal[2]);
+                continue;
+            }
+            glm::mat4 matrix(0.0f);
+            for (unsigned int k = 0; k < MAX_INFLUENCES; k++)
+                matrix += palette[ids[k]] * (weights[k] * (1.0f / 255.0f));
+            positions[v] = glm::vec3(matrix * glm::vec4(position[0], position[1], position[2], 1.0f));
+            normals[v] = glm::normalize(glm::vec3(matrix * glm::vec4(normal[0], normal[1], normal[2], 0.0f)));
+        }
+    }
+
+#ifdef SKINNING_AVX2
+    // blends the four matrices as two 256 bit halves of two columns each, then transforms with 128 bit FMAs
+    static void skinAvx2(const void *vertices, size_t count, size_t stride, size_t normalOffset, size_t boneOffset,
+                         const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals)
+    {
+        const char *data = static_cast<const char *>(vertices);
+        const float *matrices = &palette[0][0][0];
+        const __m256 toUnit = _mm256_set1_ps(1.0f / 255.0f);
+        for (size_t v = 0; v < count; v++, data += stride) {
+            const float *position = reinterpret_cast<const float *>(data);
+            const float *normal = reinterpret_cast<const float *>(data + normalOffset);
+            const std::uint8_t *ids = reinterpret_cast<const std::uint8_t *>(data + boneOffset);
+            const std::uint8_t *weights = ids + MAX_INFLUENCES;
+            if (!(weights[0] | weights[1] | weights[2] | weights[3])) {
+                positions[v] = glm::vec3(position[0], position[1], position[2]);
+                normals[v] = glm::vec3(normal[0], normal[1], normal[2]);
+                continue;
+            }
+            __m256 columns01 = _mm256_setzero_ps(), columns23 = _mm256_setzero_ps();
+            for (unsigned int k = 0; k < MAX_INFLUENCES; k++) {
+                const float *matrix = matrices + ids[k] * 16;
+                __m256 weight = _mm256_mul_ps(_mm256_set1_ps(float(weights[k])), toUnit);
+                columns01 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix), columns01);
+                columns23 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix + 8), columns23);
+            }
+            __m128 column0 = _mm256_castps256_ps128(columns01), column1 = _mm256_extractf128_ps(columns01, 1);
+            __m128 column2 = _mm256_castps256_ps128(columns23), column3 = _mm256_extractf128_ps(columns23, 1);
+
+            __m128 p = _mm_fmadd_ps(column0, _mm_set1_ps(position[0]), column3);
+            p = _mm_fmadd_ps(column1, _mm_set1_ps(position[1]), p);
+            p = _mm_fmadd_ps(column2, _mm_set1_ps(position[2]), p);
+            __m128 n = _mm_mul_ps(column0, _mm_set1_ps(normal[0]));
+            n = _mm_fmadd_ps(column1, _mm_set1_ps(normal[1]), n);
+            n = _mm_fmadd_ps(column2, _mm_set1_ps(normal[2]), n);
+            n = _mm_div_ps(n, _mm_sqrt_ps(_mm_dp_ps(n, n, 0x7f)));
+
+            alignas(16) float out[8];
+            _mm_store_ps(out, p);
+            _mm_store_ps(out + 4, n);
+            positions[v] = glm::vec3(out[0], out[1], out[2]);
+            normals[v] = glm::vec3(out[4], out[5], out[6]);
+        }
+    }
+#endif
+};
+
+#endif
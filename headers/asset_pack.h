@@ -0,0 +1,270 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <streambuf>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include "mapped_file.h"
+
+// a file inside an AssetPack
+struct AssetView {
+    const char *data = nullptr;
+    size_t size = 0;
+    std::int64_t modified = 0; // mtime of the file when it was packed
+};
+
+// Many files in one memory mapped file. Layout: a header, the entries sorted by name, the names, then the file
+// contents, each starting at a 4 KiB boundary so views are page aligned. Names are relative paths as the demos
+// open them from bin/, e.g. "shaders/model/model.vs.glsl".
+class AssetPack {
+public:
+    constexpr static std::uint32_t MAGIC = 0x4b434150; // "PACK"
+    constexpr static std::uint32_t VERSION = 1;
+    constexpr static std::uint64_t ALIGNMENT = 4096;
+
+    // maps the pack and checks that the table, the names and every entry lie inside the file, so find never reads
+    // past the mapping however the file was damaged
+    bool open(const std::string &path) {
+        std::unique_ptr<MappedFile> mapped(new MappedFile(path));
+        size_t length = mapped->length();
+        if (!mapped->isOpen() || length < sizeof(Header))
+            return false;
+        const char *base = mapped->data();
+        Header header;
+        std::memcpy(&header, base, sizeof(Header));
+        if (header.magic != MAGIC || header.version != VERSION)
+            return false;
+        if (header.entryCount > (length - sizeof(Header)) / sizeof(Entry) || !inRange(header.namesOffset, header.namesSize, length))
+            return false;
+        const Entry *table = reinterpret_cast<const Entry *>(base + sizeof(Header));
+        for (size_t i = 0; i < header.entryCount; i++)
+            if (!inRange(table[i].nameOffset, table[i].nameLength, header.namesSize) || !inRange(table[i].offset, table[i].size, length))
+                return false;
+        mapped->prefetch(); // the first loads then find the pack in the page cache
+        file = std::move(mapped);
+        entries = table;
+        entryCount = header.entryCount;
+        names = base + header.namesOffset;
+        return true;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+    size_t size() const { return entryCount; }
+
+    // the packed file at path, an empty view if there is none
+    AssetView find(const std::string &path) const {
+        AssetView view;
+        if (!file) return view;
+        std::string name = normalize(path);
+        const Entry *end = entries + entryCount;
+        const Entry *entry = std::lower_bound(entries, end, name, [&](const Entry &e, const std::string &n) {
+            return compare(e, n) < 0;
+        });
+        if (entry == end || compare(*entry, name) != 0)
+            return view;
+        view.data = file->data() + entry->offset;
+        view.size = entry->size;
+        view.modified = entry->modified;
+        return view;
+    }
+
+    bool contains(const std::string &path) const { return find(path).data != nullptr; }
+
+    // the pack every loader looks in before the file system, see mount
+    static AssetPack &mounted() {
+        static AssetPack pack;
+        return pack;
+    }
+
+    // opens the pack for the loaders. Files it doesn't hold are still read from disk.
+    static bool mount(const std::string &path) {
+        return mounted().open(path);
+    }
+
+    // "./a//b/../c" -> "a/c", the form names are stored in
+    static std::string normalize(const std::string &path) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = std::min(path.find('/', start), path.size());
+            std::string part = path.substr(start, end - start);
+            if (part == ".." && !parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (!part.empty() && part != ".")
+                parts.push_back(part);
+            start = end + 1;
+        }
+        std::string name = !path.empty() && path[0] == '/' ? "/" : "";
+        for (const std::string &part : parts)
+            name += (name.empty() || name == "/" ? "" : "/") + part;
+        return name;
+    }
+
+    // packs every file below the directories into output. Returns the number of files, -1 on failure.
+    static long build(const std::vector<std::string> &directories, const std::string &output, std::string &error) {
+        std::vector<std::string> paths;
+        for (const std::string &directory : directories)
+            listFiles(normalize(directory), paths);
+        std::string skipped = normalize(output);
+        paths.erase(std::remove(paths.begin(), paths.end(), skipped), paths.end());
+        std::sort(paths.begin(), paths.end());
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+        std::vector<Entry> table(paths.size());
+        std::string nameBlob;
+        for (size_t i = 0; i < paths.size(); i++) {
+            table[i].nameOffset = nameBlob.size();
+            table[i].nameLength = paths[i].size();
+            nameBlob += paths[i];
+        }
+        Header header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.entryCount = paths.size();
+        header.namesOffset = sizeof(Header) + table.size() * sizeof(Entry);
+        header.namesSize = nameBlob.size();
+
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            error = "can't write " + output;
+            return -1;
+        }
+        // the table is written twice, a placeholder first and the real offsets once the contents are in
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(Entry));
+        out.write(nameBlob.data(), nameBlob.size());
+        std::uint64_t offset = header.namesOffset + header.namesSize;
+        std::vector<char> contents;
+        for (size_t i = 0; i < paths.size(); i++) {
+            std::uint64_t aligned = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            contents.assign(aligned - offset, 0);
+            out.write(contents.data(), contents.size());
+            MappedFile source(paths[i]);
+            struct stat info;
+            if (!source.isOpen() || stat(paths[i].c_str(), &info) != 0) {
+                error = "can't read " + paths[i];
+                return -1;
+            }
+            out.write(source.data(), source.length());
+            table[i].offset = aligned;
+            table[i].size = source.length();
+            table[i].modified = info.st_mtime;
+            offset = aligned + source.length();
+        }
+        out.seekp(sizeof(Header));
+        out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(Entry));
+        if (!out) {
+            error = "can't write " + output;
+            return -1;
+        }
+        return long(paths.size());
+    }
+
+    // appends every regular file below directory to paths
+    static void listFiles(const std::string &directory, std::vector<std::string> &paths) {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir) return;
+        while (dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..") continue;
+            std::string path = directory + '/' + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) != 0) continue;
+            if (S_ISDIR(info.st_mode))
+                listFiles(path, paths);
+            else if (S_ISREG(info.st_mode))
+                paths.push_back(path);
+        }
+        closedir(dir);
+    }
+
+private:
+    struct Header {
+        std::uint32_t magic, version, entryCount, reserved;
+        std::uint64_t namesOffset, namesSize;
+    };
+    struct Entry {
+        std::uint64_t offset, size;
+        std::int64_t modified;
+        std::uint32_t nameOffset, nameLength;
+    };
+
+    std::unique_ptr<MappedFile> file;
+    const Entry *entries = nullptr;
+    size_t entryCount = 0;
+    const char *names = nullptr;
+
+    // [offset, offset + size) within [0, limit), without overflowing the sum
+    static bool inRange(std::uint64_t offset, std::uint64_t size, std::uint64_t limit) {
+        return offset <= limit && size <= limit - offset;
+    }
+
+    int compare(const Entry &entry, const std::string &name) const {
+        int order = std::memcmp(names + entry.nameOffset, name.data(), std::min<size_t>(entry.nameLength, name.size()));
+        return order != 0 ? order : int(entry.nameLength) - int(name.size());
+    }
+};
+
+// A whole file, viewed in the mounted AssetPack when it holds the file and memory mapped from disk otherwise.
+// Has MappedFile's interface, so loaders written against one take the other.
+class AssetFile {
+public:
+    explicit AssetFile(const std::string &path) : view(AssetPack::mounted().find(path)) {
+        if (!view.data)
+            file.reset(new MappedFile(path));
+    }
+
+    bool isOpen() const { return view.data || file->isOpen(); }
+    bool isPacked() const { return view.data != nullptr; }
+    const char *data() const { return view.data ? view.data : file->data(); }
+    size_t length() const { return view.data ? view.size : file->length(); }
+
+private:
+    AssetView view;
+    std::unique_ptr<MappedFile> file;
+};
+
+// size and modification time of a file, from the mounted pack if it holds the file
+inline bool assetStat(const std::string &path, std::uint64_t &size, std::int64_t &modified) {
+    AssetView view = AssetPack::mounted().find(path);
+    if (view.data) {
+        size = view.size;
+        modified = view.modified;
+        return true;
+    }
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    size = info.st_size;
+    modified = info.st_mtime;
+    return true;
+}
+
+// read-only std::streambuf over memory, lets stream based readers read an AssetFile without a copy
+class MemoryStreamBuffer : public std::streambuf {
+public:
+    MemoryStreamBuffer(const char *data, size_t size) {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override {
+        char *base = direction == std::ios_base::beg ? eback() : direction == std::ios_base::cur ? gptr() : egptr();
+        if (base + offset < eback() || base + offset > egptr()) return pos_type(off_type(-1));
+        setg(eback(), base + offset, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode mode) override {
+        return seekoff(off_type(position), std::ios_base::beg, mode);
+    }
+};
+
+#endif
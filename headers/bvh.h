@@ -0,0 +1,488 @@
+#ifndef BVH_H
+#define BVH_H
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <mutex>
+#include <cmath>
+#include <cfloat>
+#include <glm/glm.hpp>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BVH_SSE 1
+#endif
+#include "parallel.h"
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // need not be normalized, hit distances are in units of direction
+    float tMax;
+
+    Ray() : origin(0.0f), direction(0.0f, 0.0f, -1.0f), tMax(FLT_MAX) {}
+    Ray(glm::vec3 origin, glm::vec3 direction, float tMax = FLT_MAX) : origin(origin), direction(direction), tMax(tMax) {}
+};
+
+struct RayHit {
+    float t = FLT_MAX;
+    unsigned int triangle = ~0u; // triangle number in the index buffer the BVH was built from, ~0u for a miss
+    float u = 0.0f, v = 0.0f;    // barycentrics of the hit point
+
+    bool hit() const { return triangle != ~0u; }
+};
+
+// 32 byte node. The two children of an interior node are stored next to each other.
+struct BVHNode {
+    float boundsMin[3];
+    unsigned int leftFirst; // left child for interior nodes, first triangle for leaves
+    float boundsMax[3];
+    unsigned int count;     // triangles in a leaf, 0 for interior nodes
+
+    bool isLeaf() const { return count > 0; }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode should fill half a cache line");
+
+// Bounding volume hierarchy over the triangles of one mesh, built top down with binned SAH
+// (Wald 2007). Large nodes are binned in parallel. Rays are traced one at a time or as packets
+// of four with SSE, the packet path falls back to four single rays without SSE.
+class BVH {
+public:
+    constexpr static unsigned int BIN_COUNT = 16;
+    constexpr static unsigned int MAX_LEAF_SIZE = 8;   // larger leaves are split even when SAH disagrees
+    constexpr static unsigned int MAX_DEPTH = 64;      // also the traversal stack size
+    constexpr static float TRAVERSAL_COST = 1.0f;      // relative to one triangle test
+    constexpr static size_t PARALLEL_GRAIN = 1 << 14;  // triangles per thread when binning big nodes
+
+    void build(const std::vector<unsigned int> &indices, const float *positions, size_t stride) {
+        nodes.clear();
+        triangles.clear();
+        triangleIds.clear();
+        size_t count = indices.size() / 3;
+        if (count == 0) return;
+
+        std::vector<Bounds> boxes(count);
+        std::vector<glm::vec3> centroids(count);
+        parallelFor(0, count, PARALLEL_GRAIN, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                Bounds box;
+                for (int k = 0; k < 3; k++)
+                    box.grow(position(positions, stride, indices[i * 3 + k]));
+                boxes[i] = box;
+                centroids[i] = (box.min + box.max) * 0.5f;
+            }
+        });
+
+        std::vector<unsigned int> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        nodes.reserve(count * 2);
+        nodes.push_back(BVHNode());
+        nodes[0].leftFirst = 0;
+        nodes[0].count = count;
+
+        struct Pending { unsigned int node, depth; };
+        std::vector<Pending> stack(1, Pending{ 0, 0 });
+        while (!stack.empty()) {
+            Pending pending = stack.back();
+            stack.pop_back();
+            unsigned int left;
+            if (split(pending.node, pending.depth, boxes, centroids, order, &left)) {
+                stack.push_back(Pending{ left + 1, pending.depth + 1 });
+                stack.push_back(Pending{ left, pending.depth + 1 });
+            }
+        }
+        nodes.shrink_to_fit();
+
+        // triangles in leaf order, with the edges Moller-Trumbore needs
+        triangles.resize(count);
+        triangleIds = order;
+        for (size_t i = 0; i < count; i++) {
+            const unsigned int *corner = &indices[order[i] * 3];
+            glm::vec3 v0 = position(positions, stride, corner[0]);
+            triangles[i].v0 = v0;
+            triangles[i].e1 = position(positions, stride, corner[1]) - v0;
+            triangles[i].e2 = position(positions, stride, corner[2]) - v0;
+        }
+    }
+
+    bool empty() const { return nodes.empty(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t triangleCount() const { return triangles.size(); }
+
+    // closest hit along the ray that is nearer than hit.t, returns true if hit was updated
+    bool intersect(const Ray &ray, RayHit &hit) const {
+        if (nodes.empty()) return false;
+        glm::vec3 invDirection = 1.0f / ray.direction;
+        float tMax = std::min(ray.tMax, hit.t);
+        bool found = false;
+
+        struct Entry { unsigned int node; float t; };
+        Entry stack[MAX_DEPTH];
+        int top = 0;
+        float rootT = intersectNode(nodes[0], ray.origin, invDirection, tMax);
+        if (rootT == FLT_MAX) return false;
+        stack[top++] = Entry{ 0, rootT };
+        while (top > 0) {
+            Entry entry = stack[--top];
+            if (entry.t >= tMax) continue; // a closer hit was found since this node was pushed
+            const BVHNode &node = nodes[entry.node];
+            if (node.isLeaf()) {
+                for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                    float t, u, v;
+                    if (intersectTriangle(triangles[i], ray, tMax, t, u, v)) {
+                        tMax = t;
+                        hit.t = t;
+                        hit.u = u;
+                        hit.v = v;
+                        hit.triangle = triangleIds[i];
+                        found = true;
+                    }
+                }
+                continue;
+            }
+            unsigned int near = node.leftFirst, far = node.leftFirst + 1;
+            float tNear = intersectNode(nodes[near], ray.origin, invDirection, tMax);
+            float tFar = intersectNode(nodes[far], ray.origin, invDirection, tMax);
+            if (tFar < tNear) {
+                std::swap(near, far);
+                std::swap(tNear, tFar);
+            }
+            // the nearer child is popped first
+            if (tFar != FLT_MAX) stack[top++] = Entry{ far, tFar };
+            if (tNear != FLT_MAX) stack[top++] = Entry{ near, tNear };
+        }
+        return found;
+    }
+
+    // four rays at once, coherent rays (camera or picking rays) share most of the traversal
+    void intersectPacket(const Ray rays[4], RayHit hits[4]) const {
+#ifdef BVH_SSE
+        intersectPacketSSE(rays, hits);
+#else
+        for (int i = 0; i < 4; i++)
+            intersect(rays[i], hits[i]);
+#endif
+    }
+
+    // triangles whose bounds overlap the box, for proximity queries
+    void query(glm::vec3 boxMin, glm::vec3 boxMax, std::vector<unsigned int> &result) const {
+        if (nodes.empty()) return;
+        unsigned int stack[MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BVHNode &node = nodes[stack[--top]];
+            if (!overlaps(node.boundsMin, node.boundsMax, boxMin, boxMax)) continue;
+            if (!node.isLeaf()) {
+                stack[top++] = node.leftFirst;
+                stack[top++] = node.leftFirst + 1;
+                continue;
+            }
+            for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+                const Triangle &triangle = triangles[i];
+                glm::vec3 v1 = triangle.v0 + triangle.e1, v2 = triangle.v0 + triangle.e2;
+                glm::vec3 triangleMin = glm::min(triangle.v0, glm::min(v1, v2));
+                glm::vec3 triangleMax = glm::max(triangle.v0, glm::max(v1, v2));
+                if (overlaps(&triangleMin.x, &triangleMax.x, boxMin, boxMax))
+                    result.push_back(triangleIds[i]);
+            }
+        }
+    }
+
+private:
+    struct Triangle {
+        glm::vec3 v0, e1, e2;
+    };
+
+    struct Bounds {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        void grow(glm::vec3 point) { min = glm::min(min, point); max = glm::max(max, point); }
+        void grow(const Bounds &other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+        float area() const {
+            if (min.x > max.x) return 0.0f;
+            glm::vec3 extent = max - min;
+            return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+        }
+    };
+
+    struct Bin {
+        Bounds bounds;
+        unsigned int count = 0;
+    };
+
+    std::vector<BVHNode> nodes;
+    std::vector<Triangle> triangles;
+    std::vector<unsigned int> triangleIds;
+
+    static glm::vec3 position(const float *positions, size_t stride, unsigned int index) {
+        const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + index * stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    static bool overlaps(const float *min, const float *max, glm::vec3 boxMin, glm::vec3 boxMax) {
+        return min[0] <= boxMax.x && max[0] >= boxMin.x && min[1] <= boxMax.y && max[1] >= boxMin.y
+            && min[2] <= boxMax.z && max[2] >= boxMin.z;
+    }
+
+    // fills in the node bounds and splits it if SAH says so, returns true with the index of the new left child
+    bool split(unsigned int index, unsigned int depth, const std::vector<Bounds> &boxes,
+               const std::vector<glm::vec3> &centroids, std::vector<unsigned int> &order, unsigned int *left) {
+        unsigned int first = nodes[index].leftFirst, count = nodes[index].count;
+        Bounds bounds, centroidBounds;
+        std::mutex mutex;
+        parallelFor(first, first + count, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+            Bounds localBounds, localCentroids;
+            for (size_t i = begin; i < end; i++) {
+                localBounds.grow(boxes[order[i]]);
+                localCentroids.grow(centroids[order[i]]);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            bounds.grow(localBounds);
+            centroidBounds.grow(localCentroids);
+        });
+        for (int c = 0; c < 3; c++) {
+            nodes[index].boundsMin[c] = bounds.min[c];
+            nodes[index].boundsMax[c] = bounds.max[c];
+        }
+        if (count <= 1 || depth + 1 >= MAX_DEPTH) return false;
+
+        // bin the centroids along all three axes at once
+        glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+        glm::vec3 scale;
+        for (int axis = 0; axis < 3; axis++)
+            scale[axis] = extent[axis] > 0.0f ? BIN_COUNT / extent[axis] : 0.0f;
+        Bin bins[3][BIN_COUNT];
+        parallelFor(first, first + count, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+            Bin local[3][BIN_COUNT];
+            for (size_t i = begin; i < end; i++) {
+                unsigned int triangle = order[i];
+                for (int axis = 0; axis < 3; axis++) {
+                    Bin &bin = local[axis][binIndex(centroids[triangle][axis], centroidBounds.min[axis], scale[axis])];
+                    bin.bounds.grow(boxes[triangle]);
+                    bin.count++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int axis = 0; axis < 3; axis++)
+                for (unsigned int b = 0; b < BIN_COUNT; b++) {
+                    bins[axis][b].bounds.grow(local[axis][b].bounds);
+                    bins[axis][b].count += local[axis][b].count;
+                }
+        });
+
+        // sweep the bin boundaries, cost in triangle tests relative to the parent area
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        unsigned int bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            if (scale[axis] == 0.0f) continue;
+            float rightArea[BIN_COUNT];
+            unsigned int rightCount[BIN_COUNT];
+            Bounds accumulated;
+            unsigned int accumulatedCount = 0;
+            for (unsigned int b = BIN_COUNT - 1; b > 0; b--) {
+                accumulated.grow(bins[axis][b].bounds);
+                accumulatedCount += bins[axis][b].count;
+                rightArea[b] = accumulated.area();
+                rightCount[b] = accumulatedCount;
+            }
+            accumulated = Bounds();
+            accumulatedCount = 0;
+            for (unsigned int b = 1; b < BIN_COUNT; b++) {
+                accumulated.grow(bins[axis][b - 1].bounds);
+                accumulatedCount += bins[axis][b - 1].count;
+                if (accumulatedCount == 0 || rightCount[b] == 0) continue;
+                float cost = accumulated.area() * accumulatedCount + rightArea[b] * rightCount[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        float parentArea = bounds.area();
+        float splitCost = TRAVERSAL_COST + (parentArea > 0.0f ? bestCost / parentArea : 0.0f);
+        if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= float(count)))
+            return false;
+
+        unsigned int *begin = &order[first], *end = begin + count, *middle;
+        if (bestAxis >= 0) {
+            middle = std::partition(begin, end, [&](unsigned int triangle) {
+                return binIndex(centroids[triangle][bestAxis], centroidBounds.min[bestAxis], scale[bestAxis]) < bestSplit;
+            });
+        } else {
+            // all centroids coincide, split the list in half to keep leaves small
+            middle = begin + count / 2;
+        }
+
+        *left = nodes.size();
+        nodes.push_back(BVHNode());
+        nodes.push_back(BVHNode());
+        nodes[*left].leftFirst = first;
+        nodes[*left].count = middle - begin;
+        nodes[*left + 1].leftFirst = first + (middle - begin);
+        nodes[*left + 1].count = end - middle;
+        nodes[index].leftFirst = *left;
+        nodes[index].count = 0;
+        return true;
+    }
+
+    static unsigned int binIndex(float centroid, float min, float scale) {
+        int bin = int((centroid - min) * scale);
+        return std::min(unsigned(std::max(bin, 0)), BIN_COUNT - 1);
+    }
+
+    // entry distance of the ray into the node, FLT_MAX on a miss
+    static float intersectNode(const BVHNode &node, glm::vec3 origin, glm::vec3 invDirection, float tMax) {
+        float tEnter = 0.0f, tExit = tMax;
+        for (int c = 0; c < 3; c++) {
+            float t0 = (node.boundsMin[c] - origin[c]) * invDirection[c];
+            float t1 = (node.boundsMax[c] - origin[c]) * invDirection[c];
+            tEnter = std::max(tEnter, std::min(t0, t1));
+            tExit = std::min(tExit, std::max(t0, t1));
+        }
+        return tEnter <= tExit ? tEnter : FLT_MAX;
+    }
+
+    // Moller-Trumbore, hits in (0, tMax)
+    static bool intersectTriangle(const Triangle &triangle, const Ray &ray, float tMax, float &t, float &u, float &v) {
+        glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+        float det = glm::dot(triangle.e1, p);
+        if (std::abs(det) < 1e-12f) return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = ray.origin - triangle.v0;
+        u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+        glm::vec3 q = glm::cross(s, triangle.e1);
+        v = glm::dot(ray.direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+        t = glm::dot(triangle.e2, q) * invDet;
+        return t > 0.0f && t < tMax;
+    }
+
+#ifdef BVH_SSE
+    struct Packet {
+        __m128 origin[3], direction[3], invDirection[3];
+    };
+
+    // lanes whose ray enters the node before its current tMax, entry distances in tEnter
+    static __m128 intersectNode4(const BVHNode &node, const Packet &packet, __m128 tMax, __m128 &tEnter) {
+        __m128 enter = _mm_setzero_ps(), exit = tMax;
+        for (int c = 0; c < 3; c++) {
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[c]), packet.origin[c]), packet.invDirection[c]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[c]), packet.origin[c]), packet.invDirection[c]);
+            enter = _mm_max_ps(enter, _mm_min_ps(t0, t1));
+            exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+        }
+        tEnter = enter;
+        return _mm_cmple_ps(enter, exit);
+    }
+
+    static __m128 select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // smallest entry distance among the active lanes
+    static float nearestEntry(__m128 mask, __m128 tEnter) {
+        float entries[4];
+        _mm_storeu_ps(entries, select(mask, tEnter, _mm_set1_ps(FLT_MAX)));
+        return std::min(std::min(entries[0], entries[1]), std::min(entries[2], entries[3]));
+    }
+
+    void intersectPacketSSE(const Ray rays[4], RayHit hits[4]) const {
+        if (nodes.empty()) return;
+        Packet packet;
+        for (int c = 0; c < 3; c++) {
+            packet.origin[c] = _mm_setr_ps(rays[0].origin[c], rays[1].origin[c], rays[2].origin[c], rays[3].origin[c]);
+            packet.direction[c] = _mm_setr_ps(rays[0].direction[c], rays[1].direction[c],
+                                              rays[2].direction[c], rays[3].direction[c]);
+            packet.invDirection[c] = _mm_div_ps(_mm_set1_ps(1.0f), packet.direction[c]);
+        }
+        __m128 tMax = _mm_setr_ps(std::min(rays[0].tMax, hits[0].t), std::min(rays[1].tMax, hits[1].t),
+                                  std::min(rays[2].tMax, hits[2].t), std::min(rays[3].tMax, hits[3].t));
+        __m128 hitU = _mm_setzero_ps(), hitV = _mm_setzero_ps();
+        __m128i hitTriangle = _mm_set1_epi32(-1);
+
+        unsigned int stack[MAX_DEPTH];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BVHNode &node = nodes[stack[--top]];
+            __m128 tEnter;
+            if (_mm_movemask_ps(intersectNode4(node, packet, tMax, tEnter)) == 0) continue;
+            if (!node.isLeaf()) {
+                // push the farther child first so the nearer one is visited next
+                __m128 enterLeft, enterRight;
+                __m128 maskLeft = intersectNode4(nodes[node.leftFirst], packet, tMax, enterLeft);
+                __m128 maskRight = intersectNode4(nodes[node.leftFirst + 1], packet, tMax, enterRight);
+                bool leftFirst = nearestEntry(maskLeft, enterLeft) <= nearestEntry(maskRight, enterRight);
+                stack[top++] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+                stack[top++] = leftFirst ? node.leftFirst : node.leftFirst + 1;
+                continue;
+            }
+            for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; i++)
+                intersectTriangle4(triangles[i], packet, tMax, hitU, hitV, hitTriangle, _mm_set1_epi32(int(i)));
+        }
+
+        float t[4], u[4], v[4];
+        int triangle[4];
+        _mm_storeu_ps(t, tMax);
+        _mm_storeu_ps(u, hitU);
+        _mm_storeu_ps(v, hitV);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(triangle), hitTriangle);
+        for (int lane = 0; lane < 4; lane++) {
+            if (triangle[lane] < 0) continue;
+            hits[lane].t = t[lane];
+            hits[lane].u = u[lane];
+            hits[lane].v = v[lane];
+            hits[lane].triangle = triangleIds[triangle[lane]];
+        }
+    }
+
+    // Moller-Trumbore on four rays against one triangle, updates the lanes that hit closer
+    static void intersectTriangle4(const Triangle &triangle, const Packet &packet, __m128 &tMax,
+                                   __m128 &hitU, __m128 &hitV, __m128i &hitTriangle, __m128i id) {
+        const __m128 *d = packet.direction;
+        __m128 e1x = _mm_set1_ps(triangle.e1.x), e1y = _mm_set1_ps(triangle.e1.y), e1z = _mm_set1_ps(triangle.e1.z);
+        __m128 e2x = _mm_set1_ps(triangle.e2.x), e2y = _mm_set1_ps(triangle.e2.y), e2z = _mm_set1_ps(triangle.e2.z);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        __m128 sx = _mm_sub_ps(packet.origin[0], _mm_set1_ps(triangle.v0.x));
+        __m128 sy = _mm_sub_ps(packet.origin[1], _mm_set1_ps(triangle.v0.y));
+        __m128 sz = _mm_sub_ps(packet.origin[2], _mm_set1_ps(triangle.v0.z));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), invDet);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+        __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        __m128 mask = _mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+        mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+        mask = _mm_and_ps(mask, _mm_cmplt_ps(t, tMax));
+        if (_mm_movemask_ps(mask) == 0) return;
+
+        tMax = select(mask, t, tMax);
+        hitU = select(mask, u, hitU);
+        hitV = select(mask, v, hitV);
+        __m128i maskInt = _mm_castps_si128(mask);
+        hitTriangle = _mm_or_si128(_mm_and_si128(maskInt, id), _mm_andnot_si128(maskInt, hitTriangle));
+    }
+#endif
+};
+
+#endif // BVH_H
@@ -0,0 +1,164 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+#include "asset_pack.h"
+
+// Collects the files below some directories that were written, on a thread of its own. On Linux inotify wakes
+// the thread when a file is closed after writing or renamed into place. Elsewhere, macOS included, the thread
+// compares modification times every POLL_INTERVAL_MS. Directories created after the watcher are not watched.
+class FileWatcher {
+public:
+    constexpr static int POLL_INTERVAL_MS = 250;
+
+    explicit FileWatcher(const std::vector<std::string> &roots)
+    {
+        for (const std::string &root : roots)
+            addDirectories(AssetPack::normalize(root));
+#ifdef __linux__
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor >= 0)
+            for (const std::string &directory : directories) {
+                int watch = inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if (watch >= 0) watches[watch] = directory;
+            }
+#endif
+        if (descriptor < 0)
+            scan(false);
+        thread = std::thread(&FileWatcher::run, this);
+    }
+
+    ~FileWatcher()
+    {
+        stopping = true;
+        thread.join();
+        if (descriptor >= 0) close(descriptor);
+    }
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // the files written since the last call, each once. Only takes a lock, never waits for the disk.
+    std::vector<std::string> changes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> files(changed.begin(), changed.end());
+        changed.clear();
+        return files;
+    }
+
+    bool usesInotify() const { return descriptor >= 0; }
+
+private:
+    std::vector<std::string> directories;
+    std::map<int, std::string> watches;         // inotify watch descriptor to directory
+    std::map<std::string, long long> modified;  // file to modification time in ns, when polling
+    int descriptor = -1;
+    std::atomic<bool> stopping{ false };
+    std::mutex mutex;
+    std::set<std::string> changed;
+    std::thread thread;
+
+    void addDirectories(const std::string &directory)
+    {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir) return;
+        directories.push_back(directory);
+        while (dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..") continue;
+            std::string path = directory + '/' + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+                addDirectories(path);
+        }
+        closedir(dir);
+    }
+
+    void run()
+    {
+        while (!stopping) {
+            if (descriptor >= 0) {
+                readEvents();
+            } else {
+                // int() so the constant isn't bound to a reference, which needs a definition before C++17
+                std::this_thread::sleep_for(std::chrono::milliseconds(int(POLL_INTERVAL_MS)));
+                scan(true);
+            }
+        }
+    }
+
+    void readEvents()
+    {
+#ifdef __linux__
+        pollfd request = { descriptor, POLLIN, 0 };
+        if (poll(&request, 1, POLL_INTERVAL_MS) <= 0) return; // the timeout lets the thread see stopping
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const char *p = buffer; p < buffer + length;) {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+                auto watch = watches.find(event->wd);
+                if (watch != watches.end() && event->len > 0)
+                    changed.insert(watch->second + '/' + event->name);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+#endif
+    }
+
+    // reports the files whose modification time differs from the last scan, and the new ones
+    void scan(bool report)
+    {
+        std::vector<std::string> files;
+        for (const std::string &directory : directories) {
+            DIR *dir = opendir(directory.c_str());
+            if (!dir) continue;
+            while (dirent *entry = readdir(dir))
+                files.push_back(directory + '/' + entry->d_name);
+            closedir(dir);
+        }
+        std::map<std::string, long long> times;
+        for (const std::string &file : files) {
+            struct stat info;
+            if (stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+                times[file] = modificationTime(info);
+        }
+        if (report) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &time : times) {
+                auto before = modified.find(time.first);
+                if (before == modified.end() || before->second != time.second)
+                    changed.insert(time.first);
+            }
+        }
+        modified.swap(times);
+    }
+
+    static long long modificationTime(const struct stat &info)
+    {
+#ifdef __APPLE__
+        return info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+        return info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+    }
+};
+
+#endif
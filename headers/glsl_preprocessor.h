@@ -0,0 +1,132 @@
+#ifndef GLSL_PREPROCESSOR_H
+#define GLSL_PREPROCESSOR_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <cctype>
+#include "asset_pack.h"
+
+// #define NAME VALUE lines selecting a shader variant, the value may be empty
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// The part of shader preprocessing GLSL can't do itself: #include "file", relative to the including file and
+// each file at most once per stage, and #defines injected right after #version. #line directives keep the
+// compiler's line numbers pointing into the original files, with the index of the file in files as the
+// source string number.
+class GlslPreprocessor {
+public:
+    constexpr static int MAX_DEPTH = 32;
+
+    static bool process(const std::string &path, const ShaderDefines &defines, std::string &output,
+                        std::vector<std::string> &files, std::string &error)
+    {
+        output.clear();
+        files.clear();
+        return processFile(AssetPack::normalize(path), &defines, 0, output, files, error);
+    }
+
+    // the lines for defines, sorted so the same set always gives the same text
+    static std::string defineLines(const ShaderDefines &defines)
+    {
+        ShaderDefines sorted = defines;
+        std::sort(sorted.begin(), sorted.end());
+        std::string lines;
+        for (const auto &define : sorted)
+            lines += "#define " + define.first + (define.second.empty() ? "" : " " + define.second) + "\n";
+        return lines;
+    }
+
+private:
+    // defines is set for the stage's own file, which must hold the #version
+    static bool processFile(const std::string &path, const ShaderDefines *defines, int depth, std::string &output,
+                            std::vector<std::string> &files, std::string &error)
+    {
+        if (depth > MAX_DEPTH) {
+            error = path + ": includes nested too deep";
+            return false;
+        }
+        AssetFile file(path);
+        if (!file.isOpen()) {
+            error = "can't read " + path;
+            return false;
+        }
+        int index = int(files.size());
+        files.push_back(path);
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        const char *data = file.data(), *end = data + file.length();
+        bool definesWritten = defines == nullptr;
+        for (int line = 1; data < end; line++) {
+            const char *lineEnd = std::find(data, end, '\n');
+            std::string text(data, lineEnd);
+            data = lineEnd < end ? lineEnd + 1 : end;
+            std::string directive = directiveName(text);
+
+            if (directive == "version") {
+                if (!defines) {
+                    error = path + "(" + std::to_string(line) + "): #version in an included file";
+                    return false;
+                }
+                output += text + "\n" + defineLines(*defines) + lineDirective(line + 1, index);
+                definesWritten = true;
+            } else if (directive == "include") {
+                size_t open = text.find('"'), close = text.rfind('"');
+                if (open == std::string::npos || close == open) {
+                    error = path + "(" + std::to_string(line) + "): expected #include \"file\"";
+                    return false;
+                }
+                std::string included = AssetPack::normalize(directory + text.substr(open + 1, close - open - 1));
+                if (std::find(files.begin(), files.end(), included) != files.end()) {
+                    output += "\n"; // already in this stage
+                    continue;
+                }
+                if (!definesWritten) { // no #version before, the defines still go first
+                    output += defineLines(*defines);
+                    definesWritten = true;
+                }
+                output += lineDirective(1, int(files.size()));
+                if (!processFile(included, nullptr, depth + 1, output, files, error))
+                    return false;
+                output += lineDirective(line + 1, index);
+            } else {
+                if (!definesWritten && !blankOrComment(text)) {
+                    output += defineLines(*defines) + lineDirective(line, index);
+                    definesWritten = true;
+                }
+                output += text + "\n";
+            }
+        }
+        if (!definesWritten)
+            output += defineLines(*defines);
+        return true;
+    }
+
+    // "version" for "  #  version 410 core", "" for lines that are no directive
+    static std::string directiveName(const std::string &line)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] != '#') return "";
+        start = line.find_first_not_of(" \t", start + 1);
+        if (start == std::string::npos) return "";
+        size_t end = start;
+        while (end < line.size() && isalpha(static_cast<unsigned char>(line[end]))) end++;
+        return line.substr(start, end - start);
+    }
+
+    // lines that may come before #version
+    static bool blankOrComment(const std::string &line)
+    {
+        size_t start = line.find_first_not_of(" \t\r");
+        return start == std::string::npos || line.compare(start, 2, "//") == 0;
+    }
+
+    // the next line is number line of source string file
+    static std::string lineDirective(int line, int file)
+    {
+        return "#line " + std::to_string(line) + " " + std::to_string(file) + "\n";
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include "json.h"
+#include "asset_pack.h"
+
+// a slice of a glTF buffer
+struct GltfBufferView {
+    int buffer;
+    size_t byteOffset, byteLength;
+    size_t byteStride; // 0 for tightly packed elements
+};
+
+// how to read typed elements out of a buffer view. componentType uses the GL enum values (GL_FLOAT is 5126...),
+// so it is passed to glVertexAttribPointer and glDrawElements as is.
+struct GltfAccessor {
+    int bufferView; // -1 for accessors without data, which are all zeros
+    size_t byteOffset;
+    std::uint32_t componentType;
+    int components; // 1 for SCALAR up to 16 for MAT4
+    bool normalized;
+    size_t count;
+};
+
+// The JSON and the binary buffers of a glTF 2.0 file, without touching any vertex. A .glb is memory mapped and its
+// BIN chunk viewed in place, .gltf files read their buffers from the .bin files they name, mapped too.
+class GltfDocument {
+public:
+    constexpr static std::uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+    constexpr static std::uint32_t GLB_VERSION = 2;
+    constexpr static std::uint32_t CHUNK_JSON = 0x4e4f534a;
+    constexpr static std::uint32_t CHUNK_BIN = 0x004e4942;
+
+    JsonValue json;
+    std::vector<GltfBufferView> bufferViews;
+    std::vector<GltfAccessor> accessors;
+
+    bool load(const std::string &path, std::string &error)
+    {
+        file.reset(new AssetFile(path));
+        if (!file->isOpen()) {
+            error = "can't open " + path;
+            return false;
+        }
+        const char *data = file->data();
+        size_t length = file->length();
+        const char *jsonText = data;
+        size_t jsonLength = length;
+        const char *bin = nullptr;
+        size_t binLength = 0;
+        if (length >= 12 && read32(data) == GLB_MAGIC) {
+            if (read32(data + 4) != GLB_VERSION) {
+                error = "unsupported glb version " + std::to_string(read32(data + 4));
+                return false;
+            }
+            jsonText = nullptr;
+            size_t end = std::min<size_t>(read32(data + 8), length);
+            for (size_t offset = 12; offset + 8 <= end;) {
+                size_t chunkLength = read32(data + offset);
+                std::uint32_t chunkType = read32(data + offset + 4);
+                if (chunkLength > end - offset - 8) {
+                    error = "truncated chunk";
+                    return false;
+                }
+                if (chunkType == CHUNK_JSON && !jsonText) {
+                    jsonText = data + offset + 8;
+                    jsonLength = chunkLength;
+                } else if (chunkType == CHUNK_BIN && !bin) {
+                    bin = data + offset + 8;
+                    binLength = chunkLength;
+                }
+                offset += 8 + (chunkLength + 3) / 4 * 4;
+            }
+            if (!jsonText) {
+                error = "no JSON chunk";
+                return false;
+            }
+        }
+        if (!JsonValue::parse(jsonText, jsonLength, json, error))
+            return false;
+        if (json["asset"]["version"].asString().compare(0, 2, "2.") != 0) {
+            error = "not a glTF 2.0 asset";
+            return false;
+        }
+
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        const JsonValue &bufferList = json["buffers"];
+        for (size_t i = 0; i < bufferList.size(); i++) {
+            const std::string &uri = bufferList[i]["uri"].asString();
+            size_t declared = size_t(bufferList[i]["byteLength"].asNumber());
+            Buffer buffer = { nullptr, 0 };
+            if (uri.empty() && i == 0 && bin) { // the glb's own buffer
+                buffer.data = bin;
+                buffer.size = binLength;
+            } else if (!uri.empty() && uri.compare(0, 5, "data:") != 0) {
+                externalFiles.emplace_back(new AssetFile(directory + uri));
+                if (!externalFiles.back()->isOpen()) {
+                    error = "can't open buffer " + directory + uri;
+                    return false;
+                }
+                buffer.data = externalFiles.back()->data();
+                buffer.size = externalFiles.back()->length();
+            } else {
+                error = "buffer " + std::to_string(i) + " is not in the file or a .bin, data: URIs are not supported";
+                return false;
+            }
+            if (declared > buffer.size) {
+                error = "buffer " + std::to_string(i) + " is shorter than its byteLength";
+                return false;
+            }
+            buffer.size = declared;
+            buffers.push_back(buffer);
+        }
+
+        const JsonValue &viewList = json["bufferViews"];
+        bufferViews.resize(viewList.size());
+        for (size_t i = 0; i < viewList.size(); i++) {
+            GltfBufferView &view = bufferViews[i];
+            view.buffer = viewList[i]["buffer"].asInt(-1);
+            view.byteOffset = size_t(viewList[i]["byteOffset"].asNumber());
+            view.byteLength = size_t(viewList[i]["byteLength"].asNumber());
+            view.byteStride = size_t(viewList[i]["byteStride"].asNumber());
+            if (view.buffer < 0 || view.buffer >= int(buffers.size()) || view.byteOffset > buffers[view.buffer].size
+                    || view.byteLength > buffers[view.buffer].size - view.byteOffset) {
+                error = "buffer view " + std::to_string(i) + " is outside its buffer";
+                return false;
+            }
+        }
+
+        const JsonValue &accessorList = json["accessors"];
+        accessors.resize(accessorList.size());
+        for (size_t i = 0; i < accessorList.size(); i++) {
+            const JsonValue &info = accessorList[i];
+            GltfAccessor &accessor = accessors[i];
+            accessor.bufferView = info["bufferView"].asInt(-1);
+            accessor.byteOffset = size_t(info["byteOffset"].asNumber());
+            accessor.componentType = std::uint32_t(info["componentType"].asNumber());
+            accessor.components = componentCount(info["type"].asString());
+            accessor.normalized = info["normalized"].asBool();
+            accessor.count = size_t(info["count"].asNumber());
+            if (!info["sparse"].isNull()) {
+                error = "accessor " + std::to_string(i) + " is sparse, which is not supported";
+                return false;
+            }
+            if (accessor.bufferView >= int(bufferViews.size()) || componentSize(accessor.componentType) == 0
+                    || accessor.components == 0 || !fits(accessor)) {
+                error = "accessor " + std::to_string(i) + " is invalid or outside its buffer view";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // first byte of a buffer view in the mapped file
+    const char *viewData(int view) const
+    {
+        return buffers[bufferViews[view].buffer].data + bufferViews[view].byteOffset;
+    }
+
+    // bytes between the starts of consecutive elements of accessor
+    size_t stride(const GltfAccessor &accessor) const
+    {
+        size_t byteStride = accessor.bufferView >= 0 ? bufferViews[accessor.bufferView].byteStride : 0;
+        return byteStride ? byteStride : elementSize(accessor);
+    }
+
+    static size_t elementSize(const GltfAccessor &accessor)
+    {
+        return componentSize(accessor.componentType) * accessor.components;
+    }
+
+    static size_t componentSize(std::uint32_t componentType)
+    {
+        switch (componentType) {
+        case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+        case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+        case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+        default: return 0;
+        }
+    }
+
+    static int componentCount(const std::string &type)
+    {
+        static const char *const names[] = { "SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4" };
+        static const int counts[] = { 1, 2, 3, 4, 4, 9, 16 };
+        for (int i = 0; i < 7; i++)
+            if (type == names[i]) return counts[i];
+        return 0;
+    }
+
+    static std::uint32_t read32(const char *data)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+private:
+    struct Buffer {
+        const char *data;
+        size_t size;
+    };
+
+    std::unique_ptr<AssetFile> file;
+    std::vector<std::unique_ptr<AssetFile>> externalFiles;
+    std::vector<Buffer> buffers;
+
+    // the last element of accessor ends inside its buffer view
+    bool fits(const GltfAccessor &accessor) const
+    {
+        if (accessor.bufferView < 0 || accessor.count == 0) return true;
+        const GltfBufferView &view = bufferViews[accessor.bufferView];
+        if (accessor.count > view.byteLength) return false; // also keeps the span below from overflowing
+        size_t span = (accessor.count - 1) * stride(accessor) + elementSize(accessor);
+        return accessor.byteOffset <= view.byteLength && span <= view.byteLength - accessor.byteOffset;
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef JSON_H
+#define JSON_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+
+// Small read-only JSON document, enough for glTF. Lookups of missing members or items return a null value,
+// so paths like json["materials"][i]["pbrMetallicRoughness"]["baseColorTexture"]["index"].asInt(-1) need no checks.
+class JsonValue {
+public:
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == NUL; }
+    size_t size() const { return kind == ARRAY ? items.size() : kind == OBJECT ? members.size() : 0; }
+
+    const JsonValue &operator[](size_t index) const {
+        return kind == ARRAY && index < items.size() ? items[index] : null();
+    }
+
+    const JsonValue &operator[](const char *name) const {
+        if (kind == OBJECT)
+            for (const auto &member : members)
+                if (member.first == name) return member.second;
+        return null();
+    }
+
+    const std::vector<std::pair<std::string, JsonValue>> &objectMembers() const { return members; }
+
+    double asNumber(double fallback = 0.0) const { return kind == NUMBER ? number : fallback; }
+    int asInt(int fallback = 0) const { return kind == NUMBER ? int(number) : fallback; }
+    bool asBool(bool fallback = false) const { return kind == BOOLEAN ? boolean : fallback; }
+    const std::string &asString() const { return kind == STRING ? text : null().text; }
+
+    // parses size bytes of text, error says where it failed
+    static bool parse(const char *data, size_t size, JsonValue &value, std::string &error) {
+        Parser parser = { data, data + size, std::string() };
+        value = JsonValue();
+        if (parser.value(value, 0) && (parser.skipSpace(), parser.p == parser.end))
+            return true;
+        error = parser.error.empty() ? "unexpected text" : parser.error;
+        error += " at byte " + std::to_string(parser.p - data);
+        return false;
+    }
+
+private:
+    constexpr static int MAX_DEPTH = 256;
+
+    Type kind = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    static const JsonValue &null() {
+        static const JsonValue value;
+        return value;
+    }
+
+    struct Parser {
+        const char *p, *end;
+        std::string error;
+
+        void skipSpace() {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+        }
+
+        bool literal(const char *word) {
+            size_t length = std::strlen(word);
+            if (size_t(end - p) < length || std::memcmp(p, word, length) != 0) return false;
+            p += length;
+            return true;
+        }
+
+        bool value(JsonValue &out, int depth) {
+            if (depth > MAX_DEPTH) {
+                error = "nested too deep";
+                return false;
+            }
+            skipSpace();
+            if (p == end) {
+                error = "unexpected end";
+                return false;
+            }
+            switch (*p) {
+            case '{': return object(out, depth);
+            case '[': return array(out, depth);
+            case '"': out.kind = STRING; return string(out.text);
+            case 't': out.kind = BOOLEAN; out.boolean = true; return literal("true") || fail("bad literal");
+            case 'f': out.kind = BOOLEAN; out.boolean = false; return literal("false") || fail("bad literal");
+            case 'n': out.kind = NUL; return literal("null") || fail("bad literal");
+            default: return numberValue(out);
+            }
+        }
+
+        bool fail(const char *message) {
+            error = message;
+            return false;
+        }
+
+        bool object(JsonValue &out, int depth) {
+            out.kind = OBJECT;
+            p++; // {
+            skipSpace();
+            if (p < end && *p == '}') { p++; return true; }
+            while (true) {
+                skipSpace();
+                std::pair<std::string, JsonValue> member;
+                if (p == end || *p != '"' || !string(member.first)) return fail("expected a member name");
+                skipSpace();
+                if (p == end || *p++ != ':') return fail("expected ':'");
+                if (!value(member.second, depth + 1)) return false;
+                out.members.push_back(std::move(member));
+                skipSpace();
+                if (p < end && *p == ',') { p++; continue; }
+                if (p < end && *p == '}') { p++; return true; }
+                return fail("expected ',' or '}'");
+            }
+        }
+
+        bool array(JsonValue &out, int depth) {
+            out.kind = ARRAY;
+            p++; // [
+            skipSpace();
+            if (p < end && *p == ']') { p++; return true; }
+            while (true) {
+                out.items.emplace_back();
+                if (!value(out.items.back(), depth + 1)) return false;
+                skipSpace();
+                if (p < end && *p == ',') { p++; continue; }
+                if (p < end && *p == ']') { p++; return true; }
+                return fail("expected ',' or ']'");
+            }
+        }
+
+        bool numberValue(JsonValue &out) {
+            // strtod needs a terminated string, numbers are short so copy the candidate characters
+            char buffer[64];
+            size_t length = 0;
+            while (p + length < end && length + 1 < sizeof(buffer) && std::strchr("+-0123456789.eE", p[length]))
+                length++;
+            if (length == 0) return fail("unexpected character");
+            std::memcpy(buffer, p, length);
+            buffer[length] = '\0';
+            char *parsed;
+            out.kind = NUMBER;
+            out.number = std::strtod(buffer, &parsed);
+            if (parsed == buffer) return fail("bad number");
+            p += parsed - buffer;
+            return true;
+        }
+
+        static void appendUtf8(std::string &text, unsigned int code) {
+            if (code < 0x80) {
+                text += char(code);
+            } else if (code < 0x800) {
+                text += char(0xc0 | code >> 6);
+                text += char(0x80 | (code & 0x3f));
+            } else if (code < 0x10000) {
+                text += char(0xe0 | code >> 12);
+                text += char(0x80 | (code >> 6 & 0x3f));
+                text += char(0x80 | (code & 0x3f));
+            } else {
+                text += char(0xf0 | code >> 18);
+                text += char(0x80 | (code >> 12 & 0x3f));
+                text += char(0x80 | (code >> 6 & 0x3f));
+                text += char(0x80 | (code & 0x3f));
+            }
+        }
+
+        bool hex4(unsigned int &code) {
+            if (end - p < 4) return false;
+            code = 0;
+            for (int i = 0; i < 4; i++) {
+                char c = *p++;
+                code <<= 4;
+                if (c >= '0' && c <= '9') code |= c - '0';
+                else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+
+        bool string(std::string &text) {
+            p++; // "
+            while (p < end && *p != '"') {
+                if (*p != '\\') {
+                    text += *p++;
+                    continue;
+                }
+                if (++p == end) break;
+                char escape = *p++;
+                switch (escape) {
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u': {
+                    unsigned int code;
+                    if (!hex4(code)) return fail("bad \\u escape");
+                    unsigned int low;
+                    if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u'
+                            && (p += 2, hex4(low)) && low >= 0xdc00 && low < 0xe000)
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00); // surrogate pair
+                    appendUtf8(text, code);
+                    break;
+                }
+                default: text += escape; break; // \" \\ \/
+                }
+            }
+            if (p == end) return fail("unterminated string");
+            p++; // "
+            return true;
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Read-only view of a whole file, memory mapped where possible.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) : mapped(nullptr), size(0) {
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return;
+        struct stat info;
+        if (fstat(descriptor, &info) == 0 && info.st_size > 0) {
+            size = size_t(info.st_size);
+            void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (address != MAP_FAILED) {
+                mapped = static_cast<const char *>(address);
+            } else {
+                // e.g. special files, fall back to reading
+                copy.resize(size);
+                size_t done = 0;
+                ssize_t count;
+                while (done < size && (count = read(descriptor, &copy[done], size - done)) > 0)
+                    done += size_t(count);
+                copy.resize(done);
+                size = done;
+            }
+        }
+        close(descriptor);
+        opened = true;
+    }
+
+    ~MappedFile() {
+        if (mapped) munmap(const_cast<char *>(mapped), size);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return opened; }
+    bool isMapped() const { return mapped != nullptr; }
+    const char *data() const { return mapped ? mapped : copy.empty() ? "" : copy.data(); }
+    size_t length() const { return size; }
+
+    // asks the kernel to read the whole mapping ahead, in one sequential pass instead of page faults
+    void prefetch() const {
+        if (mapped) madvise(const_cast<char *>(mapped), size, MADV_WILLNEED);
+    }
+
+private:
+    const char *mapped;
+    size_t size;
+    std::vector<char> copy;
+    bool opened = false;
+};
+
+#endif
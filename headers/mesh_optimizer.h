@@ -0,0 +1,548 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "parallel.h"
+
+struct VertexCacheStats {
+    float acmr; // average cache miss ratio, transformed vertices per triangle (0.5 - 3.0)
+    float atvr; // average transformed vertex ratio, transformed vertices per referenced vertex (1.0 - ...)
+};
+
+// A contiguous run of triangles in a mesh's index buffer, small enough to be culled on its own.
+struct Meshlet {
+    glm::vec3 center;      // bounding sphere
+    float radius;
+    glm::vec3 coneAxis;    // average facing of the triangles
+    float coneCutoff;      // sin of the cone's half angle, 1 when the cluster can't be backface culled
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+// Index buffer reordering for the post-transform vertex cache, overdraw and vertex fetch.
+// Positions are read through a byte stride so any interleaved vertex struct can be passed in.
+class MeshOptimizer {
+public:
+    constexpr static unsigned int DEFAULT_CACHE_SIZE = 16;
+    constexpr static float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+    constexpr static size_t WELD_GRAIN = 1 << 15;
+    constexpr static double WELD_CELL = 8.0; // grid cell size in epsilons, larger cells need fewer neighbours
+    constexpr static unsigned int MESHLET_MAX_VERTICES = 64;
+    constexpr static unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+    // Merges vertices that are bit-identical (epsilon == 0) or whose float components all differ by at most
+    // epsilon, compacting vertices in place and rewriting indices. Returns the new vertex count. Every vertex
+    // goes to the lowest index within epsilon of it, so a chain of close vertices becomes one.
+    // T must be a multiple of 4 bytes. Only its first floatCount components are floats compared with epsilon,
+    // the rest (like packed bytes) is always compared bit for bit. Meshes above WELD_GRAIN vertices are
+    // hashed and merged in parallel.
+    template<typename T>
+    static size_t weldVertices(std::vector<T> &vertices, std::vector<unsigned int> &indices, float epsilon = 0.0f,
+                               size_t floatCount = sizeof(T) / sizeof(float)) {
+        static_assert(sizeof(T) % sizeof(float) == 0, "weldVertices expects a vertex made of 4 byte components");
+        const size_t components = sizeof(T) / sizeof(float);
+        const size_t count = vertices.size();
+        if (count == 0) return 0;
+
+        // the first (up to) three floats, the position, pick a cell of a grid with WELD_CELL * epsilon wide
+        // cells. A vertex within epsilon is then in the same cell, or in the neighbour across a face that is
+        // less than epsilon away.
+        const float *data = reinterpret_cast<const float *>(vertices.data());
+        const size_t tolerant = epsilon > 0.0f ? floatCount : 0; // components compared with epsilon
+        const size_t axes = std::min<size_t>(3, tolerant);
+        const double inverseCell = epsilon > 0.0f ? 1.0 / (WELD_CELL * epsilon) : 0.0;
+        auto bits = [&](size_t v, size_t c) {
+            uint32_t value;
+            std::memcpy(&value, &data[v * components + c], sizeof(value));
+            return value;
+        };
+        auto locate = [&](size_t v, int64_t *cell, int64_t *side) {
+            for (size_t a = 0; a < axes; a++) {
+                double scaled = data[v * components + a] * inverseCell;
+                double lower = std::floor(scaled);
+                cell[a] = int64_t(lower);
+                double offset = scaled - lower, reach = 1.001 / WELD_CELL; // a bit over epsilon, for float rounding
+                side[a] = offset < reach ? -1 : 1.0 - offset < reach ? 1 : 0;
+            }
+        };
+        // the cell and the components compared bit for bit
+        auto hashCell = [&](size_t v, const int64_t *cell) {
+            uint64_t hash = 0;
+            for (size_t a = 0; a < axes; a++)
+                hash ^= uint64_t(cell[a]) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+            for (size_t c = tolerant; c < components; c++)
+                hash ^= bits(v, c) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+            // MurmurHash3's finalizer, the high bits pick the shard and the low ones the table slot
+            hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdull;
+            hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53ull;
+            return hash ^ (hash >> 33);
+        };
+        auto within = [&](size_t a, size_t b) {
+            for (size_t c = 0; c < components; c++) {
+                if (c < tolerant) {
+                    if (!(std::abs(data[a * components + c] - data[b * components + c]) <= epsilon)) return false;
+                } else if (bits(a, c) != bits(b, c))
+                    return false;
+            }
+            return true;
+        };
+
+        std::vector<uint64_t> hashes(count);
+        parallelFor(0, count, WELD_GRAIN, [&](size_t first, size_t last) {
+            int64_t cell[3], side[3];
+            for (size_t v = first; v < last; v++) {
+                locate(v, cell, side);
+                hashes[v] = hashCell(v, cell);
+            }
+        });
+
+        // (hash, index) entries sorted by both. The vertices are split once into shards of consecutive hash
+        // ranges, chunk by chunk, and each shard is sorted on its own.
+        const size_t shards = count > WELD_GRAIN ? workerCount() : 1, chunks = shards;
+        auto shardOf = [&](uint64_t hash) { return size_t(((hash >> 32) * shards) >> 32); };
+        auto chunkBegin = [&](size_t chunk) { return count * chunk / chunks; };
+        std::vector<size_t> starts(shards * chunks + 1, 0); // of the entries of each shard from each chunk
+        parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+            for (size_t chunk = first; chunk < last; chunk++)
+                for (size_t v = chunkBegin(chunk); v < chunkBegin(chunk + 1); v++)
+                    starts[shardOf(hashes[v]) * chunks + chunk + 1]++;
+        });
+        std::partial_sum(starts.begin(), starts.end(), starts.begin());
+        std::vector<size_t> shardStarts(shards + 1, count);
+        for (size_t shard = 0; shard < shards; shard++)
+            shardStarts[shard] = starts[shard * chunks];
+        std::vector<std::pair<uint64_t, unsigned int>> entries(count);
+        parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+            for (size_t chunk = first; chunk < last; chunk++)
+                for (size_t v = chunkBegin(chunk); v < chunkBegin(chunk + 1); v++)
+                    entries[starts[shardOf(hashes[v]) * chunks + chunk]++] = { hashes[v], unsigned(v) };
+        });
+        // and per shard an open addressing table of the first entry of every hash, at most half full
+        std::vector<size_t> tableStarts(shards + 1, 0);
+        for (size_t shard = 0; shard < shards; shard++) {
+            size_t size = 1;
+            while (size < 2 * (shardStarts[shard + 1] - shardStarts[shard])) size *= 2;
+            tableStarts[shard + 1] = tableStarts[shard] + size;
+        }
+        const unsigned int EMPTY = ~0u;
+        std::vector<unsigned int> table(tableStarts[shards], EMPTY);
+        parallelFor(0, shards, 1, [&](size_t first, size_t last) {
+            for (size_t shard = first; shard < last; shard++) {
+                std::sort(entries.begin() + shardStarts[shard], entries.begin() + shardStarts[shard + 1]);
+                size_t mask = tableStarts[shard + 1] - tableStarts[shard] - 1;
+                for (size_t e = shardStarts[shard]; e < shardStarts[shard + 1]; e++) {
+                    if (e > shardStarts[shard] && entries[e].first == entries[e - 1].first) continue;
+                    size_t slot = entries[e].first & mask;
+                    while (table[tableStarts[shard] + slot] != EMPTY) slot = (slot + 1) & mask;
+                    table[tableStarts[shard] + slot] = unsigned(e);
+                }
+            }
+        });
+        auto find = [&](uint64_t hash) {
+            size_t shard = shardOf(hash), mask = tableStarts[shard + 1] - tableStarts[shard] - 1;
+            for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+                unsigned int e = table[tableStarts[shard] + slot];
+                if (e == EMPTY || entries[e].first == hash) return e;
+            }
+        };
+
+        // the lowest index within epsilon in the cells around, then follow it to the lowest of its chain
+        std::vector<unsigned int> remap(count);
+        parallelFor(0, count, WELD_GRAIN, [&](size_t first, size_t last) {
+            int64_t cell[3], side[3], probe[3];
+            for (size_t v = first; v < last; v++) {
+                locate(v, cell, side);
+                unsigned int lowest = unsigned(v);
+                for (size_t corner = 0; corner < (size_t(1) << axes); corner++) {
+                    bool probed = true;
+                    for (size_t a = 0; a < axes; a++) {
+                        bool across = (corner >> a) & 1;
+                        probed = probed && !(across && side[a] == 0);
+                        probe[a] = cell[a] + (across ? side[a] : 0);
+                    }
+                    if (!probed) continue;
+                    uint64_t hash = corner == 0 ? hashes[v] : hashCell(v, probe);
+                    for (unsigned int e = find(hash); e != EMPTY && e < count && entries[e].first == hash
+                                                      && entries[e].second < lowest; e++)
+                        if (within(entries[e].second, v)) {
+                            lowest = entries[e].second;
+                            break;
+                        }
+                }
+                remap[v] = lowest;
+            }
+        });
+        for (size_t v = 0; v < count; v++)
+            remap[v] = remap[remap[v]]; // remap[v] <= v, so it is final already
+
+        std::vector<unsigned int> newIndex(count);
+        size_t unique = 0;
+        for (size_t v = 0; v < count; v++) {
+            if (remap[v] == v) {
+                if (unique != v)
+                    vertices[unique] = vertices[v];
+                newIndex[v] = unsigned(unique++);
+            } else
+                newIndex[v] = newIndex[remap[v]];
+        }
+        vertices.resize(unique);
+        parallelFor(0, indices.size(), WELD_GRAIN, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                indices[i] = newIndex[indices[i]];
+        });
+        return unique;
+    }
+
+    // simulates a FIFO post-transform cache
+    static VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                               unsigned int cacheSize = DEFAULT_CACHE_SIZE) {
+        VertexCacheStats stats = { 0.0f, 0.0f };
+        if (indices.empty()) return stats;
+
+        std::vector<size_t> timestamps(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        size_t time = cacheSize + 1, misses = 0, unique = 0;
+        for (unsigned int index : indices) {
+            if (time - timestamps[index] > cacheSize) {
+                timestamps[index] = time++;
+                misses++;
+            }
+            if (!referenced[index]) {
+                referenced[index] = true;
+                unique++;
+            }
+        }
+        stats.acmr = float(misses) / (indices.size() / 3);
+        stats.atvr = float(misses) / unique;
+        return stats;
+    }
+
+    // Tipsify (Sander et al. 2007). Fills clusters with the first triangle of every run that
+    // started after a cache flush, these are safe cut points for optimizeOverdraw.
+    static void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount,
+                                    std::vector<unsigned int> *clusters = nullptr,
+                                    unsigned int cacheSize = DEFAULT_CACHE_SIZE) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return;
+
+        // vertex -> triangle adjacency
+        std::vector<unsigned int> liveCount(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(indices.size());
+        for (unsigned int index : indices)
+            liveCount[index]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + liveCount[v];
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = unsigned(i / 3);
+
+        std::vector<size_t> timestamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnd, candidates, result;
+        result.reserve(indices.size());
+        deadEnd.reserve(indices.size());
+        if (clusters) clusters->clear();
+
+        size_t time = cacheSize + 1, cursor = 0;
+        long fanning = nextLiveVertex(liveCount, deadEnd, cursor);
+        bool flushed = true;
+        while (fanning >= 0) {
+            candidates.clear();
+            for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle]) continue;
+                if (flushed && clusters)
+                    clusters->push_back(unsigned(result.size() / 3));
+                flushed = false;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[triangle * 3 + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveCount[v]--;
+                    if (time - timestamps[v] > cacheSize)
+                        timestamps[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+
+            // pick the candidate that will still be in the cache after its remaining triangles
+            long best = -1;
+            size_t bestPriority = 0;
+            for (unsigned int v : candidates) {
+                if (liveCount[v] == 0) continue;
+                size_t priority = 0;
+                if (time - timestamps[v] + 2 * liveCount[v] <= cacheSize)
+                    priority = time - timestamps[v];
+                if (best < 0 || priority > bestPriority) {
+                    best = v;
+                    bestPriority = priority;
+                }
+            }
+            if (best < 0) {
+                best = nextLiveVertex(liveCount, deadEnd, cursor);
+                flushed = true;
+            }
+            fanning = best;
+        }
+        indices.swap(result);
+    }
+
+    // Sorts the clusters from optimizeVertexCache so that outward facing ones are drawn first. Clusters
+    // are subdivided further as long as the cache efficiency stays within threshold of the original.
+    static void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<unsigned int> &clusters,
+                                 const float *positions, size_t vertexCount, size_t stride,
+                                 float threshold = DEFAULT_OVERDRAW_THRESHOLD,
+                                 unsigned int cacheSize = DEFAULT_CACHE_SIZE) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || clusters.empty()) return;
+
+        std::vector<unsigned int> cuts = softBoundaries(indices, clusters, vertexCount, threshold, cacheSize);
+        cuts.push_back(unsigned(triangleCount));
+
+        // mesh centroid weighted by area
+        std::vector<glm::vec3> centroids(cuts.size() - 1), normals(cuts.size() - 1);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t c = 0; c + 1 < cuts.size(); c++) {
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (unsigned int t = cuts[c]; t < cuts[c + 1]; t++) {
+                glm::vec3 p0 = position(positions, stride, indices[t * 3 + 0]);
+                glm::vec3 p1 = position(positions, stride, indices[t * 3 + 1]);
+                glm::vec3 p2 = position(positions, stride, indices[t * 3 + 2]);
+                glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float a = glm::length(n);
+                centroid += (p0 + p1 + p2) * (a / 3.0f);
+                normal += n;
+                area += a;
+            }
+            meshCentroid += centroid;
+            meshArea += area;
+            centroids[c] = area > 0.0f ? centroid / area : position(positions, stride, indices[cuts[c] * 3]);
+            float length = glm::length(normal);
+            normals[c] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        std::vector<float> sortKey(cuts.size() - 1);
+        std::vector<unsigned int> order(cuts.size() - 1);
+        for (size_t c = 0; c < order.size(); c++) {
+            sortKey[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+            order[c] = unsigned(c);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            return sortKey[a] > sortKey[b];
+        });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (unsigned int c : order)
+            result.insert(result.end(), indices.begin() + cuts[c] * 3, indices.begin() + cuts[c + 1] * 3);
+        indices.swap(result);
+    }
+
+    // Returns the old -> new vertex remap that orders vertices by first use, rewriting indices in place.
+    // Unreferenced vertices map to ~0u and should be dropped by the caller, see remapVertices.
+    static std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int> &indices, size_t vertexCount,
+                                                         size_t *uniqueCount = nullptr) {
+        std::vector<unsigned int> remap(vertexCount, ~0u);
+        unsigned int next = 0;
+        for (unsigned int &index : indices) {
+            if (remap[index] == ~0u)
+                remap[index] = next++;
+            index = remap[index];
+        }
+        if (uniqueCount) *uniqueCount = next;
+        return remap;
+    }
+
+    template<typename T>
+    static void remapVertices(std::vector<T> &vertices, const std::vector<unsigned int> &remap, size_t uniqueCount) {
+        std::vector<T> result(uniqueCount);
+        for (size_t i = 0; i < vertices.size(); i++)
+            if (remap[i] != ~0u)
+                result[remap[i]] = vertices[i];
+        vertices.swap(result);
+    }
+
+    // Cuts the index buffer into meshlets of consecutive triangles with at most maxVertices unique vertices
+    // and maxTriangles triangles. Run it after optimizeVertexCache so neighbouring triangles share vertices.
+    static std::vector<Meshlet> buildMeshlets(const std::vector<unsigned int> &indices, const float *positions,
+                                              size_t vertexCount, size_t stride,
+                                              unsigned int maxVertices = MESHLET_MAX_VERTICES,
+                                              unsigned int maxTriangles = MESHLET_MAX_TRIANGLES) {
+        std::vector<Meshlet> meshlets;
+        std::vector<unsigned int> owner(vertexCount, ~0u); // meshlet that last used the vertex
+        std::vector<glm::vec3> points;
+        size_t first = 0;
+        unsigned int uniqueCount = 0;
+        for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+            unsigned int id = meshlets.size(), added = 0;
+            for (int k = 0; k < 3; k++)
+                added += owner[indices[i + k]] != id && (k < 1 || indices[i + k] != indices[i]) &&
+                         (k < 2 || indices[i + k] != indices[i + 1]);
+            if (i > first && (uniqueCount + added > maxVertices || (i - first) / 3 >= maxTriangles)) {
+                meshlets.push_back(meshletBounds(indices, first, i, positions, stride, points));
+                first = i;
+                uniqueCount = 0;
+                id++;
+            }
+            for (int k = 0; k < 3; k++)
+                if (owner[indices[i + k]] != id) {
+                    owner[indices[i + k]] = id;
+                    uniqueCount++;
+                }
+        }
+        if (first < indices.size() / 3 * 3)
+            meshlets.push_back(meshletBounds(indices, first, indices.size() / 3 * 3, positions, stride, points));
+        return meshlets;
+    }
+
+    // Ritter's bounding sphere, slightly larger than optimal but one pass after finding the initial diameter
+    static void boundingSphere(const glm::vec3 *points, size_t count, glm::vec3 &center, float &radius) {
+        center = glm::vec3(0.0f);
+        radius = 0.0f;
+        if (count == 0) return;
+        // start from the most distant pair found by two sweeps
+        auto farthest = [&](glm::vec3 from) {
+            glm::vec3 best = from;
+            float bestDistance = -1.0f;
+            for (size_t i = 0; i < count; i++) {
+                float distance = glm::dot(points[i] - from, points[i] - from);
+                if (distance > bestDistance) {
+                    bestDistance = distance;
+                    best = points[i];
+                }
+            }
+            return best;
+        };
+        glm::vec3 a = farthest(points[0]), b = farthest(a);
+        center = (a + b) * 0.5f;
+        radius = glm::length(b - a) * 0.5f;
+        // grow to enclose the outliers
+        for (size_t i = 0; i < count; i++) {
+            float distance = glm::length(points[i] - center);
+            if (distance > radius) {
+                float grown = (radius + distance) * 0.5f;
+                center += (points[i] - center) * ((grown - radius) / distance);
+                radius = grown;
+            }
+        }
+    }
+
+private:
+    // sphere and normal cone of the triangles in [first, last) of indices
+    static Meshlet meshletBounds(const std::vector<unsigned int> &indices, size_t first, size_t last,
+                                 const float *positions, size_t stride, std::vector<glm::vec3> &points) {
+        Meshlet meshlet;
+        meshlet.firstIndex = first;
+        meshlet.indexCount = last - first;
+
+        points.clear();
+        glm::vec3 normalSum(0.0f);
+        std::vector<glm::vec3> normals;
+        normals.reserve((last - first) / 3);
+        for (size_t i = first; i < last; i += 3) {
+            glm::vec3 a = position(positions, stride, indices[i]);
+            glm::vec3 b = position(positions, stride, indices[i + 1]);
+            glm::vec3 c = position(positions, stride, indices[i + 2]);
+            points.push_back(a);
+            points.push_back(b);
+            points.push_back(c);
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if (length > 0.0f) {
+                normals.push_back(normal / length);
+                normalSum += normal / length;
+            }
+        }
+        boundingSphere(points.data(), points.size(), meshlet.center, meshlet.radius);
+
+        // Culling test, for a camera at eye: dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+        float sumLength = glm::length(normalSum);
+        if (sumLength > 0.0f) {
+            glm::vec3 axis = normalSum / sumLength;
+            float minDot = 1.0f;
+            for (const glm::vec3 &normal : normals)
+                minDot = std::min(minDot, glm::dot(axis, normal));
+            meshlet.coneAxis = axis;
+            if (minDot > 0.0f) // the cone is narrower than a hemisphere
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+        return meshlet;
+    }
+
+    static glm::vec3 position(const float *positions, size_t stride, unsigned int index) {
+        const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + index * stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    static long nextLiveVertex(const std::vector<unsigned int> &liveCount, std::vector<unsigned int> &deadEnd,
+                               size_t &cursor) {
+        while (!deadEnd.empty()) {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveCount[v] > 0) return v;
+        }
+        for (; cursor < liveCount.size(); cursor++)
+            if (liveCount[cursor] > 0) return long(cursor);
+        return -1;
+    }
+
+    // splits every hard cluster where the running ACMR drops under threshold * cluster ACMR
+    static std::vector<unsigned int> softBoundaries(const std::vector<unsigned int> &indices,
+                                                    const std::vector<unsigned int> &clusters, size_t vertexCount,
+                                                    float threshold, unsigned int cacheSize) {
+        size_t triangleCount = indices.size() / 3;
+        std::vector<size_t> timestamps(vertexCount, 0);
+        size_t time = cacheSize + 1;
+        std::vector<unsigned int> cuts;
+
+        for (size_t c = 0; c < clusters.size(); c++) {
+            unsigned int begin = clusters[c];
+            unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : unsigned(triangleCount);
+
+            time += cacheSize + 1; // flush
+            size_t clusterMisses = 0;
+            for (size_t i = begin * 3; i < end * 3; i++)
+                if (time - timestamps[indices[i]] > cacheSize) {
+                    timestamps[indices[i]] = time++;
+                    clusterMisses++;
+                }
+            float clusterAcmr = float(clusterMisses) / (end - begin);
+
+            cuts.push_back(begin);
+            time += cacheSize + 1;
+            size_t misses = 0, start = begin;
+            for (unsigned int t = begin; t < end; t++) {
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[t * 3 + k];
+                    if (time - timestamps[v] > cacheSize) {
+                        timestamps[v] = time++;
+                        misses++;
+                    }
+                }
+                if (t + 1 < end && float(misses) / (t + 1 - start) <= clusterAcmr * threshold) {
+                    cuts.push_back(t + 1);
+                    time += cacheSize + 1;
+                    misses = 0;
+                    start = t + 1;
+                }
+            }
+        }
+        return cuts;
+    }
+};
+
+#endif // MESH_OPTIMIZER_H
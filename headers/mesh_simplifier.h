@@ -0,0 +1,291 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Quadric error metric simplification (Garland & Heckbert 1997) by collapsing edges onto one of their
+// endpoints, so the result only references existing vertices and all LODs can share one vertex buffer.
+// Vertices on attribute seams or non-manifold edges never move; open borders only collapse along the border.
+class MeshSimplifier {
+public:
+    // Returns at least targetIndexCount indices when the mesh can be reduced that far. resultError is the
+    // largest RMS distance of a collapsed vertex to its original neighbourhood, in mesh units.
+    static std::vector<unsigned int> simplify(const std::vector<unsigned int> &indices, const float *positions,
+                                              size_t vertexCount, size_t stride, size_t targetIndexCount,
+                                              float *resultError = nullptr) {
+        std::vector<glm::vec3> points(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + v * stride);
+            points[v] = glm::vec3(p[0], p[1], p[2]);
+        }
+        std::vector<unsigned int> wedges, wedgeCount;
+        buildPositionRemap(points, wedges, wedgeCount);
+
+        std::vector<unsigned int> result(indices);
+        std::vector<Quadric> quadrics(vertexCount);
+        std::vector<Kind> kinds(vertexCount);
+        std::unordered_map<uint64_t, unsigned int> edges;
+        classify(result, wedges, wedgeCount, edges, kinds);
+        computeQuadrics(result, wedges, points, edges, quadrics);
+
+        float maxError = 0.0f;
+        std::vector<unsigned int> adjacencyOffsets, adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<unsigned int> target(vertexCount);
+        std::vector<bool> locked(vertexCount);
+        for (int pass = 0; result.size() > targetIndexCount; pass++) {
+            if (pass > 0) // topology changed, reclassify. Quadrics keep accumulating
+                classify(result, wedges, wedgeCount, edges, kinds);
+            buildAdjacency(result, wedges, vertexCount, adjacencyOffsets, adjacency);
+            collectCollapses(result, wedges, points, quadrics, kinds, edges, collapses);
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+                return a.error < b.error;
+            });
+
+            for (size_t v = 0; v < vertexCount; v++) {
+                target[v] = unsigned(v);
+                locked[v] = false;
+            }
+            size_t triangles = result.size() / 3, goal = targetIndexCount / 3, performed = 0;
+            for (const Collapse &collapse : collapses) {
+                if (triangles <= goal) break;
+                unsigned int from = wedges[collapse.from], to = wedges[collapse.to];
+                if (locked[from] || locked[to]) continue;
+
+                size_t removed = 0;
+                if (!collapseKeepsOrientation(result, wedges, points, adjacencyOffsets, adjacency, from, to, removed))
+                    continue;
+
+                target[collapse.from] = collapse.to;
+                quadrics[to].add(quadrics[from]);
+                maxError = std::max(maxError, collapse.error);
+                // freeze the one-ring, its orientation checks are stale now
+                for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+                    for (int k = 0; k < 3; k++)
+                        locked[wedges[result[adjacency[a] * 3 + k]]] = true;
+                triangles -= removed;
+                performed++;
+            }
+            if (performed == 0) break;
+
+            size_t write = 0;
+            for (size_t t = 0; t < result.size(); t += 3) {
+                unsigned int a = target[result[t]], b = target[result[t + 1]], c = target[result[t + 2]];
+                if (wedges[a] == wedges[b] || wedges[b] == wedges[c] || wedges[a] == wedges[c])
+                    continue;
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        if (resultError) *resultError = std::sqrt(maxError);
+        return result;
+    }
+
+private:
+    constexpr static double BORDER_WEIGHT = 10.0;
+
+    enum Kind { MANIFOLD, BORDER, LOCKED };
+
+    struct Collapse {
+        unsigned int from, to; // vertex indices
+        float error;
+    };
+
+    // symmetric 4x4 plane quadric, weighted by triangle area
+    struct Quadric {
+        double a2 = 0, b2 = 0, c2 = 0, d2 = 0, ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0, weight = 0;
+
+        void addPlane(glm::dvec3 n, double d, double w) {
+            a2 += w * n.x * n.x; b2 += w * n.y * n.y; c2 += w * n.z * n.z; d2 += w * d * d;
+            ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+            bc += w * n.y * n.z; bd += w * n.y * d; cd += w * n.z * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q) {
+            a2 += q.a2; b2 += q.b2; c2 += q.c2; d2 += q.d2; ab += q.ab; ac += q.ac; ad += q.ad;
+            bc += q.bc; bd += q.bd; cd += q.cd; weight += q.weight;
+        }
+
+        // mean squared distance to the accumulated planes
+        float error(const glm::vec3 &p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+                     + 2 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+            return weight > 0 ? float(std::fabs(e) / weight) : 0.0f;
+        }
+    };
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b) {
+        return (uint64_t(a) << 32) | b;
+    }
+
+    // wedges[v] is the lowest index of the vertices sharing v's position
+    static void buildPositionRemap(const std::vector<glm::vec3> &points, std::vector<unsigned int> &wedges,
+                                   std::vector<unsigned int> &wedgeCount) {
+        std::vector<unsigned int> order(points.size());
+        for (size_t v = 0; v < order.size(); v++)
+            order[v] = unsigned(v);
+        auto less = [&](unsigned int a, unsigned int b) {
+            const glm::vec3 &p = points[a], &q = points[b];
+            if (p.x != q.x) return p.x < q.x;
+            if (p.y != q.y) return p.y < q.y;
+            if (p.z != q.z) return p.z < q.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        wedges.assign(points.size(), 0);
+        wedgeCount.assign(points.size(), 0);
+        for (size_t i = 0; i < order.size();) {
+            size_t j = i;
+            while (j < order.size() && points[order[j]] == points[order[i]])
+                j++;
+            for (size_t k = i; k < j; k++)
+                wedges[order[k]] = order[i];
+            wedgeCount[order[i]] = unsigned(j - i);
+            i = j;
+        }
+    }
+
+    // directed edge counts on positions. An edge without its reverse is a border, one seen twice is non-manifold
+    static void classify(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &wedges,
+                         const std::vector<unsigned int> &wedgeCount,
+                         std::unordered_map<uint64_t, unsigned int> &edges, std::vector<Kind> &kinds) {
+        edges.clear();
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+                edges[edgeKey(wedges[indices[t + k]], wedges[indices[t + (k + 1) % 3]])]++;
+
+        std::vector<unsigned int> borderEdges(wedges.size(), 0);
+        for (size_t v = 0; v < wedges.size(); v++)
+            kinds[v] = wedgeCount[wedges[v]] > 1 ? LOCKED : MANIFOLD;
+        for (const auto &edge : edges) {
+            unsigned int a = unsigned(edge.first >> 32), b = unsigned(edge.first & 0xffffffffu);
+            if (edge.second > 1) {
+                kinds[a] = kinds[b] = LOCKED;
+                continue;
+            }
+            if (edges.find(edgeKey(b, a)) == edges.end()) {
+                borderEdges[a]++;
+                borderEdges[b]++;
+            }
+        }
+        for (size_t v = 0; v < wedges.size(); v++) {
+            if (kinds[v] == LOCKED || borderEdges[v] == 0) continue;
+            kinds[v] = borderEdges[v] == 2 ? BORDER : LOCKED;
+        }
+    }
+
+    static bool isBorderEdge(const std::unordered_map<uint64_t, unsigned int> &edges, unsigned int a, unsigned int b) {
+        return (edges.find(edgeKey(a, b)) == edges.end()) != (edges.find(edgeKey(b, a)) == edges.end());
+    }
+
+    static void computeQuadrics(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &wedges,
+                                const std::vector<glm::vec3> &points,
+                                const std::unordered_map<uint64_t, unsigned int> &edges,
+                                std::vector<Quadric> &quadrics) {
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            unsigned int corners[3] = { wedges[indices[t]], wedges[indices[t + 1]], wedges[indices[t + 2]] };
+            glm::dvec3 p0(points[corners[0]]), p1(points[corners[1]]), p2(points[corners[2]]);
+            glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            double area = glm::length(normal);
+            if (area == 0.0) continue;
+            normal /= area;
+
+            for (int k = 0; k < 3; k++)
+                quadrics[corners[k]].addPlane(normal, -glm::dot(normal, p0), area);
+
+            // planes perpendicular to border edges keep the outline in place
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = corners[k], b = corners[(k + 1) % 3];
+                if (edges.find(edgeKey(b, a)) != edges.end()) continue;
+                glm::dvec3 pa(points[a]), edge = glm::dvec3(points[b]) - pa;
+                double length = glm::length(edge);
+                if (length == 0.0) continue;
+                glm::dvec3 planeNormal = glm::normalize(glm::cross(edge, normal));
+                double weight = length * length * BORDER_WEIGHT;
+                quadrics[a].addPlane(planeNormal, -glm::dot(planeNormal, pa), weight);
+                quadrics[b].addPlane(planeNormal, -glm::dot(planeNormal, pa), weight);
+            }
+        }
+    }
+
+    static void buildAdjacency(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &wedges,
+                               size_t vertexCount, std::vector<unsigned int> &offsets,
+                               std::vector<unsigned int> &adjacency) {
+        offsets.assign(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            offsets[wedges[index] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(indices.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[wedges[indices[i]]]++] = unsigned(i / 3);
+    }
+
+    static void collectCollapses(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &wedges,
+                                 const std::vector<glm::vec3> &points, const std::vector<Quadric> &quadrics,
+                                 const std::vector<Kind> &kinds,
+                                 const std::unordered_map<uint64_t, unsigned int> &edges,
+                                 std::vector<Collapse> &collapses) {
+        collapses.clear();
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (int k = 0; k < 3; k++) {
+                unsigned int i0 = indices[t + k], i1 = indices[t + (k + 1) % 3];
+                unsigned int a = wedges[i0], b = wedges[i1];
+                bool border = isBorderEdge(edges, a, b);
+                if (a > b && !border) continue; // every edge once, the reverse half edge is seen from the other
+                                                 // triangle. Border edges have none.
+                bool aMoves = kinds[a] == MANIFOLD || (kinds[a] == BORDER && border);
+                bool bMoves = kinds[b] == MANIFOLD || (kinds[b] == BORDER && border);
+                if (!aMoves && !bMoves) continue;
+
+                float errorAB = aMoves ? quadrics[a].error(points[b]) : INFINITY;
+                float errorBA = bMoves ? quadrics[b].error(points[a]) : INFINITY;
+                if (errorAB <= errorBA)
+                    collapses.push_back({ i0, i1, errorAB });
+                else
+                    collapses.push_back({ i1, i0, errorBA });
+            }
+    }
+
+    // rejects collapses that flip a triangle around from, counts the ones that degenerate
+    static bool collapseKeepsOrientation(const std::vector<unsigned int> &indices,
+                                         const std::vector<unsigned int> &wedges,
+                                         const std::vector<glm::vec3> &points,
+                                         const std::vector<unsigned int> &offsets,
+                                         const std::vector<unsigned int> &adjacency,
+                                         unsigned int from, unsigned int to, size_t &removed) {
+        for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++) {
+            unsigned int t = adjacency[a];
+            unsigned int corners[3] = { wedges[indices[t * 3]], wedges[indices[t * 3 + 1]], wedges[indices[t * 3 + 2]] };
+            if (corners[0] == to || corners[1] == to || corners[2] == to) {
+                removed++;
+                continue;
+            }
+            glm::vec3 p[3], q[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = points[corners[k]];
+                q[k] = corners[k] == from ? points[to] : p[k];
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif // MESH_SIMPLIFIER_H
@@ -0,0 +1,434 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <glm/glm.hpp>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#define OBJ_HAS_CHARCONV 1
+#endif
+#endif
+#include "parallel.h"
+#include "asset_pack.h"
+
+struct ObjMaterial {
+    std::string name;
+    std::string diffuseMap;  // map_Kd
+    std::string specularMap; // map_Ks
+    std::string normalMap;   // map_Bump / bump, what Assimp reports as a height map
+    std::string heightMap;   // map_Ka, what Assimp reports as an ambient map
+};
+
+struct ObjVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+
+// faces between two o/g/usemtl statements, triangulated and indexed by unique v/vt/vn triplet
+struct ObjMesh {
+    std::string name;
+    int material = -1; // into ObjScene::materials
+    std::vector<ObjVertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+struct ObjScene {
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+    std::string error;
+};
+
+// Wavefront OBJ/MTL reader for the subset our assets use: v, vt, vn, f (any polygon size, negative indices),
+// o, g, usemtl, mtllib and the map_* statements. The file is memory mapped and cut into line aligned chunks
+// that are parsed in parallel; the chunks are then stitched together in file order.
+// Texture coordinates are flipped vertically like aiProcess_FlipUVs, missing normals are smoothed per position.
+class ObjLoader {
+public:
+    constexpr static size_t MIN_CHUNK_SIZE = 1 << 18; // bytes per parse thread
+
+    static bool load(const std::string &path, ObjScene &scene) {
+        AssetFile file(path);
+        if (!file.isOpen()) {
+            scene.error = "Unable to open file \"" + path + "\"";
+            return false;
+        }
+        const char *text = file.data();
+        size_t size = file.length();
+
+        // line aligned chunks
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(workerCount(), size / MIN_CHUNK_SIZE));
+        std::vector<size_t> cuts(chunkCount + 1, size);
+        cuts[0] = 0;
+        for (size_t c = 1; c < chunkCount; c++) {
+            size_t cut = std::max(cuts[c - 1], size / chunkCount * c);
+            while (cut < size && text[cut - 1] != '\n') cut++;
+            cuts[c] = cut;
+        }
+        std::vector<Chunk> chunks(chunkCount);
+        parallelFor(0, chunkCount, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++)
+                parseChunk(text + cuts[c], text + cuts[c + 1], chunks[c]);
+        });
+
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        for (const Chunk &chunk : chunks)
+            for (const Statement &statement : chunk.statements)
+                if (statement.type == Statement::LIBRARY && !loadMaterials(directory + statement.name, scene.materials))
+                    scene.error = "Unable to open material library \"" + statement.name + "\"";
+        stitch(chunks, scene);
+        return true;
+    }
+
+private:
+    // an index as written (1 based, negative = relative) resolved up to the chunk's base count
+    struct Corner {
+        int position, texCoord, normal; // 0 based, relative to the chunk if the matching bit of relative is set
+        unsigned char relative;
+    };
+    constexpr static int MISSING = INT_MIN;
+
+    struct Statement {
+        enum Type { OBJECT, MATERIAL, LIBRARY } type;
+        std::string name;
+        size_t face; // number of faces in the chunk before the statement
+    };
+
+    struct Chunk {
+        std::vector<glm::vec3> positions, normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<Corner> corners;
+        std::vector<unsigned int> faceEnds; // end of each face in corners
+        std::vector<Statement> statements;
+    };
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    static void skipSpace(const char *&p, const char *end) {
+        while (p < end && isSpace(*p)) p++;
+    }
+
+    static const char *lineEnd(const char *p, const char *end) {
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        return newline ? newline : end;
+    }
+
+    static bool parseFloat(const char *&p, const char *end, float &value) {
+        skipSpace(p, end);
+#if defined(OBJ_HAS_CHARCONV) && defined(__cpp_lib_to_chars)
+        if (p < end && *p == '+') p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+#else
+        // plain decimal parser for standard libraries without floating point from_chars
+        const char *start = p;
+        bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        double mantissa = 0.0;
+        int exponent = 0;
+        bool digits = false;
+        for (; p < end && *p >= '0' && *p <= '9'; p++, digits = true)
+            mantissa = mantissa * 10.0 + (*p - '0');
+        if (p < end && *p == '.')
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits = true, exponent--)
+                mantissa = mantissa * 10.0 + (*p - '0');
+        if (!digits) {
+            p = start;
+            return false;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char *mark = p++;
+            int sign = 1, power = 0;
+            if (p < end && (*p == '-' || *p == '+')) sign = *p++ == '-' ? -1 : 1;
+            if (p < end && *p >= '0' && *p <= '9') {
+                for (; p < end && *p >= '0' && *p <= '9'; p++)
+                    power = std::min(power * 10 + (*p - '0'), 9999);
+                exponent += sign * power;
+            } else {
+                p = mark;
+            }
+        }
+        value = float((negative ? -mantissa : mantissa) * std::pow(10.0, exponent));
+        return true;
+#endif
+    }
+
+    static bool parseInt(const char *&p, const char *end, int &value) {
+#ifdef OBJ_HAS_CHARCONV
+        if (p < end && *p == '+') p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+#else
+        bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        if (p >= end || *p < '0' || *p > '9') return false;
+        long long number = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            number = std::min(number * 10 + (*p - '0'), (long long)INT_MAX);
+        value = int(negative ? -number : number);
+        return true;
+#endif
+    }
+
+    // one v/vt/vn index, count is what the chunk has read so far
+    static int resolve(int index, size_t count, unsigned char bit, unsigned char &relative) {
+        if (index > 0) return index - 1;
+        if (index == 0) return MISSING;
+        relative |= bit;
+        return int(count) + index;
+    }
+
+    static std::string restOfLine(const char *p, const char *end) {
+        skipSpace(p, end);
+        while (end > p && isSpace(end[-1])) end--;
+        return std::string(p, end);
+    }
+
+    static void parseChunk(const char *p, const char *end, Chunk &chunk) {
+        chunk.positions.reserve((end - p) / 40);
+        chunk.corners.reserve((end - p) / 8);
+        while (p < end) {
+            const char *line = lineEnd(p, end);
+            skipSpace(p, line);
+            if (p + 1 < line && p[0] == 'v' && isSpace(p[1])) {
+                glm::vec3 position(0.0f);
+                p += 1;
+                parseFloat(p, line, position.x) && parseFloat(p, line, position.y) && parseFloat(p, line, position.z);
+                chunk.positions.push_back(position);
+            } else if (p + 2 < line && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+                glm::vec2 texCoord(0.0f);
+                p += 2;
+                parseFloat(p, line, texCoord.x) && parseFloat(p, line, texCoord.y);
+                texCoord.y = 1.0f - texCoord.y;
+                chunk.texCoords.push_back(texCoord);
+            } else if (p + 2 < line && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+                glm::vec3 normal(0.0f);
+                p += 2;
+                parseFloat(p, line, normal.x) && parseFloat(p, line, normal.y) && parseFloat(p, line, normal.z);
+                chunk.normals.push_back(normal);
+            } else if (p + 1 < line && p[0] == 'f' && isSpace(p[1])) {
+                p += 1;
+                size_t before = chunk.corners.size();
+                for (skipSpace(p, line); p < line; skipSpace(p, line)) {
+                    Corner corner = { MISSING, MISSING, MISSING, 0 };
+                    int index;
+                    if (!parseInt(p, line, index)) break;
+                    corner.position = resolve(index, chunk.positions.size(), 1, corner.relative);
+                    if (p < line && *p == '/') {
+                        p++;
+                        if (parseInt(p, line, index))
+                            corner.texCoord = resolve(index, chunk.texCoords.size(), 2, corner.relative);
+                        if (p < line && *p == '/') {
+                            p++;
+                            if (parseInt(p, line, index))
+                                corner.normal = resolve(index, chunk.normals.size(), 4, corner.relative);
+                        }
+                    }
+                    chunk.corners.push_back(corner);
+                }
+                if (chunk.corners.size() - before >= 3)
+                    chunk.faceEnds.push_back(chunk.corners.size());
+                else
+                    chunk.corners.resize(before); // points and lines are not drawn
+            } else if (p + 1 < line && (p[0] == 'o' || p[0] == 'g') && isSpace(p[1])) {
+                chunk.statements.push_back({ Statement::OBJECT, restOfLine(p + 1, line), chunk.faceEnds.size() });
+            } else if (line - p > 7 && std::strncmp(p, "usemtl", 6) == 0 && isSpace(p[6])) {
+                chunk.statements.push_back({ Statement::MATERIAL, restOfLine(p + 6, line), chunk.faceEnds.size() });
+            } else if (line - p > 7 && std::strncmp(p, "mtllib", 6) == 0 && isSpace(p[6])) {
+                chunk.statements.push_back({ Statement::LIBRARY, restOfLine(p + 6, line), chunk.faceEnds.size() });
+            }
+            p = line + 1;
+        }
+    }
+
+    static bool loadMaterials(const std::string &path, std::vector<ObjMaterial> &materials) {
+        AssetFile file(path);
+        if (!file.isOpen()) return false;
+        const char *p = file.data(), *end = p + file.length();
+        while (p < end) {
+            const char *line = lineEnd(p, end);
+            skipSpace(p, line);
+            std::string keyword;
+            while (p < line && !isSpace(*p)) keyword += *p++;
+            std::string value = restOfLine(p, line);
+            // texture options come first (-bm 1.0 file.png), the file name is the last word
+            if (keyword.compare(0, 4, "map_") == 0 || keyword == "bump")
+                value = value.substr(value.find_last_of(" \t") == std::string::npos ? 0 : value.find_last_of(" \t") + 1);
+
+            if (keyword == "newmtl") {
+                materials.push_back(ObjMaterial());
+                materials.back().name = value;
+            } else if (!materials.empty()) {
+                ObjMaterial &material = materials.back();
+                if (keyword == "map_Kd") material.diffuseMap = value;
+                else if (keyword == "map_Ks") material.specularMap = value;
+                else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump") material.normalMap = value;
+                else if (keyword == "map_Ka") material.heightMap = value;
+            }
+            p = line + 1;
+        }
+        return true;
+    }
+
+    // a run of faces that becomes one ObjMesh
+    struct Range {
+        std::string name;
+        int material;
+        size_t chunk, firstFace; // start, runs until the next range
+    };
+
+    // Makes all indices absolute, cuts the faces at o/g/usemtl statements and builds the meshes in parallel.
+    static void stitch(std::vector<Chunk> &chunks, ObjScene &scene) {
+        std::vector<glm::vec3> positions, normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<Range> ranges;
+        std::string name = "default";
+        int material = -1;
+        ranges.push_back({ name, material, 0, 0 });
+        for (size_t c = 0; c < chunks.size(); c++) {
+            Chunk &chunk = chunks[c];
+            int positionBase = positions.size(), texCoordBase = texCoords.size(), normalBase = normals.size();
+            for (Corner &corner : chunk.corners) {
+                if (corner.relative & 1) corner.position += positionBase;
+                if ((corner.relative & 2) && corner.texCoord != MISSING) corner.texCoord += texCoordBase;
+                if ((corner.relative & 4) && corner.normal != MISSING) corner.normal += normalBase;
+            }
+            positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+            texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+            normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+            std::vector<glm::vec3>().swap(chunk.positions);
+            std::vector<glm::vec2>().swap(chunk.texCoords);
+            std::vector<glm::vec3>().swap(chunk.normals);
+
+            for (const Statement &statement : chunk.statements) {
+                if (statement.type == Statement::LIBRARY) continue;
+                if (statement.type == Statement::OBJECT) name = statement.name;
+                else material = findMaterial(scene.materials, statement.name);
+                if (ranges.back().chunk == c && ranges.back().firstFace == statement.face)
+                    ranges.back() = { name, material, c, statement.face }; // nothing drawn since the last cut
+                else
+                    ranges.push_back({ name, material, c, statement.face });
+            }
+        }
+
+        std::vector<ObjMesh> meshes(ranges.size());
+        parallelFor(0, ranges.size(), 1, [&](size_t first, size_t last) {
+            for (size_t r = first; r < last; r++) {
+                const Range &range = ranges[r];
+                size_t endChunk = r + 1 < ranges.size() ? ranges[r + 1].chunk : chunks.size() - 1;
+                size_t endFace = r + 1 < ranges.size() ? ranges[r + 1].firstFace : chunks.back().faceEnds.size();
+                meshes[r].name = range.name;
+                meshes[r].material = range.material;
+                buildMesh(chunks, range.chunk, range.firstFace, endChunk, endFace, positions, texCoords, normals, meshes[r]);
+            }
+        });
+        for (ObjMesh &mesh : meshes)
+            if (!mesh.indices.empty())
+                scene.meshes.push_back(std::move(mesh));
+    }
+
+    static int findMaterial(const std::vector<ObjMaterial> &materials, const std::string &name) {
+        for (size_t i = 0; i < materials.size(); i++)
+            if (materials[i].name == name) return int(i);
+        return -1;
+    }
+
+    static uint64_t cornerKey(const Corner &corner) {
+        return (uint64_t(uint32_t(corner.position)) * 0x9E3779B97F4A7C15ull)
+             ^ (uint64_t(uint32_t(corner.texCoord)) << 21) ^ uint64_t(uint32_t(corner.normal));
+    }
+
+    // fan triangulates the faces from (startChunk, startFace) up to (endChunk, endFace)
+    static void buildMesh(const std::vector<Chunk> &chunks, size_t startChunk, size_t startFace, size_t endChunk,
+                          size_t endFace, const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords,
+                          const std::vector<glm::vec3> &normals, ObjMesh &mesh) {
+        struct Unique { Corner corner; unsigned int vertex; };
+        std::unordered_multimap<uint64_t, Unique> unique;
+        std::vector<unsigned int> cornerVertices;
+        bool missingNormals = false;
+
+        for (size_t c = startChunk; c <= endChunk && c < chunks.size(); c++) {
+            const Chunk &chunk = chunks[c];
+            size_t firstFace = c == startChunk ? startFace : 0;
+            size_t lastFace = c == endChunk ? endFace : chunk.faceEnds.size();
+            for (size_t f = firstFace; f < lastFace; f++) {
+                size_t begin = f == 0 ? 0 : chunk.faceEnds[f - 1], end = chunk.faceEnds[f];
+                cornerVertices.clear();
+                for (size_t i = begin; i < end; i++) {
+                    const Corner &corner = chunk.corners[i];
+                    if (corner.position < 0 || corner.position >= int(positions.size())) break;
+                    uint64_t key = cornerKey(corner);
+                    unsigned int vertex = ~0u;
+                    auto found = unique.equal_range(key);
+                    for (auto it = found.first; it != found.second; ++it) {
+                        const Corner &other = it->second.corner;
+                        if (other.position == corner.position && other.texCoord == corner.texCoord
+                                && other.normal == corner.normal) {
+                            vertex = it->second.vertex;
+                            break;
+                        }
+                    }
+                    if (vertex == ~0u) {
+                        vertex = mesh.vertices.size();
+                        ObjVertex objVertex;
+                        objVertex.position = positions[corner.position];
+                        bool hasTexCoord = corner.texCoord >= 0 && corner.texCoord < int(texCoords.size());
+                        bool hasNormal = corner.normal >= 0 && corner.normal < int(normals.size());
+                        objVertex.texCoords = hasTexCoord ? texCoords[corner.texCoord] : glm::vec2(0.0f);
+                        objVertex.normal = hasNormal ? normals[corner.normal] : glm::vec3(0.0f);
+                        missingNormals |= !hasNormal;
+                        mesh.vertices.push_back(objVertex);
+                        unique.insert({ key, Unique{ corner, vertex } });
+                    }
+                    cornerVertices.push_back(vertex);
+                }
+                for (size_t k = 2; k < cornerVertices.size(); k++) {
+                    mesh.indices.push_back(cornerVertices[0]);
+                    mesh.indices.push_back(cornerVertices[k - 1]);
+                    mesh.indices.push_back(cornerVertices[k]);
+                }
+            }
+        }
+        if (missingNormals)
+            smoothNormals(mesh);
+    }
+
+    // area weighted face normals summed over vertices that share a position
+    static void smoothNormals(ObjMesh &mesh) {
+        std::unordered_map<uint64_t, glm::vec3> sums;
+        auto positionKey = [](glm::vec3 p) {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (uint64_t(bits[0]) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(bits[1]) << 17) ^ uint64_t(bits[2]) * 31;
+        };
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            glm::vec3 a = mesh.vertices[mesh.indices[i]].position;
+            glm::vec3 b = mesh.vertices[mesh.indices[i + 1]].position;
+            glm::vec3 c = mesh.vertices[mesh.indices[i + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            for (int k = 0; k < 3; k++)
+                sums[positionKey(mesh.vertices[mesh.indices[i + k]].position)] += normal;
+        }
+        for (ObjVertex &vertex : mesh.vertices) {
+            if (vertex.normal != glm::vec3(0.0f)) continue;
+            glm::vec3 sum = sums[positionKey(vertex.position)];
+            float length = glm::length(sum);
+            vertex.normal = length > 0.0f ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+};
+
+#endif // OBJ_LOADER_H
@@ -0,0 +1,115 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#pragma once
+
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+
+inline unsigned int workerCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// workerCount() - 1 threads, started on first use and kept until exit, that run the chunks of parallelFor
+// together with the calling thread. Every caller works through its own job before it waits, so parallelFor
+// may be called from several threads at once and from inside a chunk.
+class WorkerPool {
+public:
+    static WorkerPool &shared() {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    // calls task(i) for every i in [0, count), returns once all calls have returned
+    template<typename Task>
+    void run(size_t count, const Task &task) {
+        Job job;
+        job.count = count;
+        job.context = &task;
+        job.call = [](const void *context, size_t index) { (*static_cast<const Task *>(context))(index); };
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs.push_back(&job);
+        wake.notify_all();
+        while (job.next < job.count)
+            runNext(job, lock);
+        done.wait(lock, [&] { return job.finished == job.count; });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+private:
+    struct Job {
+        size_t count = 0, next = 0, finished = 0; // calls in total, claimed and returned
+        const void *context = nullptr;
+        void (*call)(const void *context, size_t index) = nullptr;
+    };
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::vector<Job *> jobs; // the ones with unclaimed calls, oldest first
+    bool stopping = false;
+
+    WorkerPool() {
+        for (unsigned int i = 1; i < workerCount(); i++)
+            threads.emplace_back(&WorkerPool::work, this);
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            runNext(*jobs.front(), lock);
+        }
+    }
+
+    // claims the next call of job and makes it without holding the lock
+    void runNext(Job &job, std::unique_lock<std::mutex> &lock) {
+        size_t index = job.next++;
+        if (job.next == job.count)
+            jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+        lock.unlock();
+        job.call(job.context, index);
+        lock.lock();
+        if (++job.finished == job.count)
+            done.notify_all();
+    }
+};
+
+// Splits [begin, end) into contiguous chunks of at least grain items and calls function(first, last)
+// for each chunk on the WorkerPool. Small ranges run on the calling thread.
+template<typename Function>
+void parallelFor(size_t begin, size_t end, size_t grain, Function function) {
+    if (end <= begin) return;
+    size_t count = end - begin;
+    size_t chunks = std::min<size_t>(workerCount(), (count + grain - 1) / std::max<size_t>(grain, 1));
+    if (chunks <= 1) {
+        function(begin, end);
+        return;
+    }
+
+    size_t step = (count + chunks - 1) / chunks;
+    chunks = (count + step - 1) / step;
+    WorkerPool::shared().run(chunks, [&](size_t chunk) {
+        size_t first = begin + chunk * step;
+        function(first, std::min(first + step, end));
+    });
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,370 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSOR_SSE2 1
+#endif
+#include "parallel.h"
+#include "mapped_file.h"
+
+enum BlockFormat {
+    BLOCK_BC1, // RGB, 8 bytes per 4x4 block
+    BLOCK_BC3, // RGBA, 16 bytes
+    BLOCK_BC4, // R, 8 bytes
+    BLOCK_BC5  // RG, 16 bytes
+};
+
+struct CompressedLevel {
+    int width, height;
+    std::vector<std::uint8_t> data;
+};
+
+// a block compressed image with a mip chain down to 1x1, levels holds all of it or the part loadDds was asked for
+struct CompressedImage {
+    BlockFormat format = BLOCK_BC1;
+    int width = 0, height = 0; // of mip level 0
+    int levelCount = 0;        // in the whole chain
+    int firstLevel = 0;        // mip level of levels[0]
+    std::vector<CompressedLevel> levels;
+};
+
+// Real-time block compression after van Waveren's DXT compressor: endpoints from the inset bounding box of the
+// block, indices by projecting onto the endpoint axis. Blocks are encoded on the worker threads, with SSE2 for the
+// bounding boxes and projections. Images are stored as DDS files so other tools can read them.
+class TextureCompressor {
+public:
+    constexpr static size_t ROW_GRAIN = 4; // block rows per task
+
+    static size_t blockBytes(BlockFormat format) { return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16; }
+
+    // the format keeping the channels of a stb_image load, a 1 channel image stays red only
+    static BlockFormat formatFor(int channels)
+    {
+        return channels == 1 ? BLOCK_BC4 : channels == 2 ? BLOCK_BC5 : channels == 4 ? BLOCK_BC3 : BLOCK_BC1;
+    }
+
+    static size_t levelSize(int width, int height, BlockFormat format)
+    {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+    }
+
+    static int levelWidth(int width, int level) { return std::max(width >> level, 1); }
+
+    // first mip level of an image no larger than size texels on either side
+    static int levelFor(int width, int height, int size)
+    {
+        int level = 0;
+        while (std::max(width, height) >> level > std::max(size, 1))
+            level++;
+        return level;
+    }
+
+    // compresses pixels with 1 to 4 channels per pixel and its box filtered mip chain
+    static CompressedImage compress(const std::uint8_t *pixels, int width, int height, int channels, BlockFormat format)
+    {
+        CompressedImage image;
+        image.format = format;
+        image.width = width;
+        image.height = height;
+        std::vector<std::uint8_t> rgba(size_t(width) * height * 4);
+        for (size_t i = 0; i < size_t(width) * height; i++) {
+            const std::uint8_t *pixel = pixels + i * channels;
+            std::uint8_t *out = &rgba[i * 4];
+            if (channels <= 2) { // grey (+ alpha) is read as red (+ green) by BC4 and BC5
+                out[0] = out[1] = out[2] = pixel[0];
+                out[3] = channels == 2 ? pixel[1] : 255;
+            } else {
+                out[0] = pixel[0];
+                out[1] = pixel[1];
+                out[2] = pixel[2];
+                out[3] = channels == 4 ? pixel[3] : 255;
+            }
+            if (channels == 2 && format == BLOCK_BC5)
+                out[1] = pixel[1];
+        }
+        while (true) {
+            CompressedLevel level = { width, height, std::vector<std::uint8_t>(levelSize(width, height, format)) };
+            encodeLevel(rgba.data(), width, height, format, level.data.data());
+            image.levels.push_back(std::move(level));
+            if (width == 1 && height == 1) break;
+            rgba = downsample(rgba, width, height);
+            width = std::max(width / 2, 1);
+            height = std::max(height / 2, 1);
+        }
+        image.levelCount = image.levels.size();
+        return image;
+    }
+
+    // encodes one RGBA8 level, out holds levelSize bytes
+    static void encodeLevel(const std::uint8_t *rgba, int width, int height, BlockFormat format, std::uint8_t *out)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        size_t bytes = blockBytes(format);
+        parallelFor(0, blocksY, ROW_GRAIN, [&](size_t first, size_t last) {
+            alignas(16) std::uint8_t block[64];
+            for (size_t by = first; by < last; by++)
+                for (int bx = 0; bx < blocksX; bx++) {
+                    loadBlock(rgba, width, height, bx, int(by), block);
+                    std::uint8_t *target = out + (by * blocksX + bx) * bytes;
+                    switch (format) {
+                    case BLOCK_BC1: encodeColor(block, target); break;
+                    case BLOCK_BC3: encodeSingle(block, 3, target); encodeColor(block, target + 8); break;
+                    case BLOCK_BC4: encodeSingle(block, 0, target); break;
+                    case BLOCK_BC5: encodeSingle(block, 0, target); encodeSingle(block, 1, target + 8); break;
+                    }
+                }
+        });
+    }
+
+    static bool saveDds(const std::string &path, const CompressedImage &image)
+    {
+        if (image.levels.empty()) return false;
+        DdsHeader header = {};
+        header.size = sizeof(DdsHeader);
+        header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+        header.height = image.levels[0].height;
+        header.width = image.levels[0].width;
+        header.linearSize = image.levels[0].data.size();
+        header.mipMapCount = image.levels.size();
+        header.formatSize = 32;
+        header.formatFlags = 0x4; // four cc
+        header.fourCC = fourCC(image.format);
+        header.caps = 0x1000 | 0x8 | 0x400000; // texture, complex, mipmap
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file.write(DDS_MAGIC, 4);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const CompressedLevel &level : image.levels)
+            file.write(reinterpret_cast<const char *>(level.data.data()), level.data.size());
+        return bool(file);
+    }
+
+    // reads levels firstLevel to lastLevel of a DDS file with a BC1/3/4/5 four cc. The file is memory mapped,
+    // only the pages of the levels read are touched. An empty range still fills in the size and level count.
+    static bool loadDds(const std::string &path, CompressedImage &image, int firstLevel = 0, int lastLevel = INT_MAX)
+    {
+        MappedFile file(path);
+        return file.isOpen() && loadDds(file.data(), file.length(), image, firstLevel, lastLevel);
+    }
+
+    // like loadDds from a file, for a DDS file already in memory. Fails if the data ends early.
+    static bool loadDds(const char *data, size_t size, CompressedImage &image, int firstLevel = 0, int lastLevel = INT_MAX)
+    {
+        DdsHeader header;
+        if (size < 4 + sizeof(header) || std::memcmp(data, DDS_MAGIC, 4) != 0)
+            return false;
+        std::memcpy(&header, data + 4, sizeof(header));
+        const BlockFormat formats[] = { BLOCK_BC1, BLOCK_BC3, BLOCK_BC4, BLOCK_BC5 };
+        const BlockFormat *format = std::find_if(std::begin(formats), std::end(formats),
+                                                 [&](BlockFormat f) { return fourCC(f) == header.fourCC; });
+        if (header.size != sizeof(DdsHeader) || format == std::end(formats) || header.width == 0 || header.height == 0)
+            return false;
+
+        image.format = *format;
+        image.width = header.width;
+        image.height = header.height;
+        image.levelCount = std::max<std::uint32_t>(header.mipMapCount, 1);
+        image.firstLevel = firstLevel;
+        image.levels.clear();
+        size_t offset = 4 + sizeof(header);
+        for (int i = 0; i < firstLevel && i < image.levelCount; i++)
+            offset += levelSize(levelWidth(image.width, i), levelWidth(image.height, i), image.format);
+        for (int i = firstLevel; i <= lastLevel && i < image.levelCount; i++) {
+            int width = levelWidth(image.width, i), height = levelWidth(image.height, i);
+            size_t bytes = levelSize(width, height, image.format);
+            if (offset + bytes > size)
+                return false;
+            const std::uint8_t *level = reinterpret_cast<const std::uint8_t *>(data + offset);
+            image.levels.push_back({ width, height, std::vector<std::uint8_t>(level, level + bytes) });
+            offset += bytes;
+        }
+        return true;
+    }
+
+private:
+    constexpr static const char *DDS_MAGIC = "DDS ";
+
+    struct DdsHeader {
+        std::uint32_t size, flags, height, width, linearSize, depth, mipMapCount, reserved1[11];
+        std::uint32_t formatSize, formatFlags, fourCC, bitCount, masks[4];
+        std::uint32_t caps, caps2, caps3, caps4, reserved2;
+    };
+
+    static std::uint32_t fourCC(BlockFormat format)
+    {
+        const char *code = format == BLOCK_BC1 ? "DXT1" : format == BLOCK_BC3 ? "DXT5" : format == BLOCK_BC4 ? "ATI1" : "ATI2";
+        return std::uint32_t(code[0]) | std::uint32_t(code[1]) << 8 | std::uint32_t(code[2]) << 16 | std::uint32_t(code[3]) << 24;
+    }
+
+    // 4x4 RGBA pixels of a block, repeating the last row and column past the image edge
+    static void loadBlock(const std::uint8_t *rgba, int width, int height, int bx, int by, std::uint8_t block[64])
+    {
+        for (int y = 0; y < 4; y++) {
+            int row = std::min(by * 4 + y, height - 1);
+            for (int x = 0; x < 4; x++) {
+                int column = std::min(bx * 4 + x, width - 1);
+                std::memcpy(block + (y * 4 + x) * 4, rgba + (size_t(row) * width + column) * 4, 4);
+            }
+        }
+    }
+
+    static std::vector<std::uint8_t> downsample(const std::vector<std::uint8_t> &rgba, int width, int height)
+    {
+        int halfWidth = std::max(width / 2, 1), halfHeight = std::max(height / 2, 1);
+        std::vector<std::uint8_t> half(size_t(halfWidth) * halfHeight * 4);
+        parallelFor(0, halfHeight, 64, [&](size_t first, size_t last) {
+            for (size_t y = first; y < last; y++)
+                for (int x = 0; x < halfWidth; x++) {
+                    int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                    int y0 = std::min(int(y) * 2, height - 1), y1 = std::min(int(y) * 2 + 1, height - 1);
+                    for (int c = 0; c < 4; c++) {
+                        int sum = rgba[(size_t(y0) * width + x0) * 4 + c] + rgba[(size_t(y0) * width + x1) * 4 + c]
+                                + rgba[(size_t(y1) * width + x0) * 4 + c] + rgba[(size_t(y1) * width + x1) * 4 + c];
+                        half[(y * halfWidth + x) * 4 + c] = std::uint8_t((sum + 2) / 4);
+                    }
+                }
+        });
+        return half;
+    }
+
+    // per channel minimum and maximum of the 16 pixels
+    static void blockBounds(const std::uint8_t block[64], std::uint8_t minimum[4], std::uint8_t maximum[4])
+    {
+#ifdef TEXTURE_COMPRESSOR_SSE2
+        const __m128i *pixels = reinterpret_cast<const __m128i *>(block);
+        __m128i low = _mm_min_epu8(_mm_min_epu8(pixels[0], pixels[1]), _mm_min_epu8(pixels[2], pixels[3]));
+        __m128i high = _mm_max_epu8(_mm_max_epu8(pixels[0], pixels[1]), _mm_max_epu8(pixels[2], pixels[3]));
+        low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+        low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+        high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+        high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+        std::uint32_t lowBits = _mm_cvtsi128_si32(low), highBits = _mm_cvtsi128_si32(high);
+        std::memcpy(minimum, &lowBits, 4);
+        std::memcpy(maximum, &highBits, 4);
+#else
+        for (int c = 0; c < 4; c++) {
+            minimum[c] = 255;
+            maximum[c] = 0;
+        }
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 4; c++) {
+                minimum[c] = std::min(minimum[c], block[i * 4 + c]);
+                maximum[c] = std::max(maximum[c], block[i * 4 + c]);
+            }
+#endif
+    }
+
+    // dot products of (pixel - origin) with axis over RGB for the 16 pixels
+    static void project(const std::uint8_t block[64], const int origin[3], const int axis[3], int dots[16])
+    {
+#ifdef TEXTURE_COMPRESSOR_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i originPair = _mm_setr_epi16(origin[0], origin[1], origin[2], 0, origin[0], origin[1], origin[2], 0);
+        const __m128i axisPair = _mm_setr_epi16(axis[0], axis[1], axis[2], 0, axis[0], axis[1], axis[2], 0);
+        const __m128i *pixels = reinterpret_cast<const __m128i *>(block);
+        for (int i = 0; i < 4; i++) {
+            __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(pixels[i], zero), originPair);  // pixels 0 and 1
+            __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(pixels[i], zero), originPair); // pixels 2 and 3
+            __m128i lowSums = _mm_madd_epi16(low, axisPair), highSums = _mm_madd_epi16(high, axisPair);
+            // (rg, b0) partial sums per pixel, add the pairs
+            __m128i pairs = _mm_add_epi32(_mm_unpacklo_epi64(_mm_shuffle_epi32(lowSums, 0x88), _mm_shuffle_epi32(highSums, 0x88)),
+                                          _mm_unpacklo_epi64(_mm_shuffle_epi32(lowSums, 0xdd), _mm_shuffle_epi32(highSums, 0xdd)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dots + i * 4), pairs);
+        }
+#else
+        for (int i = 0; i < 16; i++)
+            dots[i] = (block[i * 4] - origin[0]) * axis[0] + (block[i * 4 + 1] - origin[1]) * axis[1]
+                    + (block[i * 4 + 2] - origin[2]) * axis[2];
+#endif
+    }
+
+    static std::uint16_t to565(const int color[3])
+    {
+        return std::uint16_t((color[0] * 31 + 127) / 255 << 11 | (color[1] * 63 + 127) / 255 << 5 | (color[2] * 31 + 127) / 255);
+    }
+
+    static void from565(std::uint16_t packed, int color[3])
+    {
+        int r = packed >> 11, g = packed >> 5 & 63, b = packed & 31;
+        color[0] = r << 3 | r >> 2;
+        color[1] = g << 2 | g >> 4;
+        color[2] = b << 3 | b >> 2;
+    }
+
+    // BC1 block, always in the four color mode so it is valid inside BC3 too
+    static void encodeColor(const std::uint8_t block[64], std::uint8_t out[8])
+    {
+        std::uint8_t minimum[4], maximum[4];
+        blockBounds(block, minimum, maximum);
+        int low[3], high[3];
+        for (int c = 0; c < 3; c++) { // inset the box by 1/16 of its size, the end points are rarely hit exactly
+            int inset = (maximum[c] - minimum[c]) >> 4;
+            low[c] = minimum[c] + inset;
+            high[c] = maximum[c] - inset;
+        }
+        std::uint16_t color0 = to565(high), color1 = to565(low);
+        std::uint32_t indices = 0;
+        if (color0 != color1) {
+            if (color0 < color1) { // four color mode needs color0 > color1
+                std::swap(color0, color1);
+                std::swap(low, high);
+            }
+            int end0[3], end1[3], axis[3];
+            from565(color0, end0);
+            from565(color1, end1);
+            for (int c = 0; c < 3; c++)
+                axis[c] = end0[c] - end1[c];
+            int length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+            int dots[16];
+            project(block, end1, axis, dots);
+            // steps from color1 (0) to color0 (3), mapped to the BC1 index order color0, color1, 2/3, 1/3
+            const std::uint32_t order[4] = { 1, 3, 2, 0 };
+            for (int i = 0; i < 16; i++) {
+                int step = length > 0 ? (dots[i] * 6 + length) / (2 * length) : 0;
+                step = std::min(std::max(step, 0), 3);
+                indices |= order[step] << (i * 2);
+            }
+        }
+        out[0] = std::uint8_t(color0);
+        out[1] = std::uint8_t(color0 >> 8);
+        out[2] = std::uint8_t(color1);
+        out[3] = std::uint8_t(color1 >> 8);
+        std::memcpy(out + 4, &indices, 4); // little endian
+    }
+
+    // BC4 block of one channel in the eight value mode, also the alpha of BC3 and each half of BC5
+    static void encodeSingle(const std::uint8_t block[64], int channel, std::uint8_t out[8])
+    {
+        int minimum = 255, maximum = 0;
+        for (int i = 0; i < 16; i++) {
+            minimum = std::min<int>(minimum, block[i * 4 + channel]);
+            maximum = std::max<int>(maximum, block[i * 4 + channel]);
+        }
+        std::uint64_t indices = 0;
+        if (maximum > minimum) {
+            int range = maximum - minimum;
+            for (int i = 0; i < 16; i++) {
+                // steps from the minimum (0) to the maximum (7), in BC4 order max, min, 6/7 ... 1/7
+                int step = ((block[i * 4 + channel] - minimum) * 14 + range) / (2 * range);
+                std::uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+                indices |= index << (i * 3);
+            }
+        }
+        out[0] = std::uint8_t(maximum);
+        out[1] = std::uint8_t(minimum);
+        for (int b = 0; b < 6; b++)
+            out[2 + b] = std::uint8_t(indices >> (b * 8));
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Scene graph of translation/rotation/scale transforms. The local transforms are kept as separate arrays and
+// nodes are stored parents first, so update() recomputes the world, inverse world and normal matrices of the
+// changed subtrees in one forward pass and does no matrix work at all while nothing moves.
+class TransformHierarchy
+{
+public:
+    // appends a node under parent, -1 for a root. Returns its index, which stays valid for the hierarchy's lifetime.
+    int addNode(int parent, glm::vec3 position = glm::vec3(0.0f), glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                glm::vec3 scale = glm::vec3(1.0f), const std::string &name = std::string())
+    {
+        int node = parents.size();
+        parents.push_back(parent < node ? parent : -1);
+        positions.push_back(position);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+        names.push_back(name);
+        worlds.push_back(glm::mat4(1.0f));
+        inverseWorlds.push_back(glm::mat4(1.0f));
+        normals.push_back(glm::mat3(1.0f));
+        dirty.push_back(1);
+        anyDirty = true;
+        return node;
+    }
+
+    // like addNode with the local matrix split into translation, rotation and scale. Shear is dropped.
+    int addNode(int parent, const glm::mat4 &local, const std::string &name = std::string())
+    {
+        int node = addNode(parent, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f), name);
+        setLocal(node, local);
+        return node;
+    }
+
+    void setPosition(int node, glm::vec3 position) { positions[node] = position; markDirty(node); }
+    void setRotation(int node, glm::quat rotation) { rotations[node] = rotation; markDirty(node); }
+    void setScale(int node, glm::vec3 scale) { scales[node] = scale; markDirty(node); }
+
+    void setLocal(int node, const glm::mat4 &local)
+    {
+        glm::mat3 basis(local);
+        glm::vec3 scale(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+        if (glm::determinant(basis) < 0.0f)
+            scale.x = -scale.x; // a mirror is kept as a negative scale
+        for (int c = 0; c < 3; c++)
+            if (scale[c] != 0.0f)
+                basis[c] /= scale[c];
+        positions[node] = glm::vec3(local[3]);
+        rotations[node] = glm::normalize(glm::quat_cast(basis));
+        scales[node] = scale;
+        markDirty(node);
+    }
+
+    glm::vec3 position(int node) const { return positions[node]; }
+    glm::quat rotation(int node) const { return rotations[node]; }
+    glm::vec3 scale(int node) const { return scales[node]; }
+    int parent(int node) const { return parents[node]; }
+    const std::string &name(int node) const { return names[node]; }
+    size_t size() const { return parents.size(); }
+
+    glm::mat4 local(int node) const
+    {
+        glm::mat3 basis = glm::mat3_cast(rotations[node]);
+        glm::mat4 matrix(1.0f);
+        for (int c = 0; c < 3; c++)
+            matrix[c] = glm::vec4(basis[c] * scales[node][c], 0.0f);
+        matrix[3] = glm::vec4(positions[node], 1.0f);
+        return matrix;
+    }
+
+    // matrices as of the last update()
+    const glm::mat4 &world(int node) const { return worlds[node]; }
+    const glm::mat4 &inverseWorld(int node) const { return inverseWorlds[node]; }
+    // transpose of the inverse of the upper 3x3 of world. The view space normal matrix of a rigid view
+    // (lookAt) is glm::mat3(view) * normal(node), no inverse needed per draw.
+    const glm::mat3 &normal(int node) const { return normals[node]; }
+
+    // first node with the name, -1 if there is none
+    int find(const std::string &name) const
+    {
+        auto found = std::find(names.begin(), names.end(), name);
+        return found == names.end() ? -1 : int(found - names.begin());
+    }
+
+    // recomputes the nodes that changed since the last update and everything below them.
+    // Returns the number of nodes recomputed.
+    size_t update()
+    {
+        if (!anyDirty) return 0;
+        size_t updated = 0;
+        for (size_t node = 0; node < parents.size(); node++) {
+            int parent = parents[node];
+            if (parent >= 0 && dirty[parent])
+                dirty[node] = 1;
+            if (!dirty[node]) continue;
+
+            worlds[node] = parent >= 0 ? worlds[parent] * local(node) : local(node);
+            // affine inverse, the last row of a TRS chain is always (0, 0, 0, 1)
+            glm::mat3 inverseBasis = glm::inverse(glm::mat3(worlds[node]));
+            inverseWorlds[node] = glm::mat4(inverseBasis);
+            inverseWorlds[node][3] = glm::vec4(-(inverseBasis * glm::vec3(worlds[node][3])), 1.0f);
+            normals[node] = glm::transpose(inverseBasis);
+            updated++;
+        }
+        std::fill(dirty.begin(), dirty.end(), 0);
+        anyDirty = false;
+        return updated;
+    }
+
+private:
+    // local transforms
+    std::vector<int> parents;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<std::string> names;
+    // cached results
+    std::vector<glm::mat4> worlds;
+    std::vector<glm::mat4> inverseWorlds;
+    std::vector<glm::mat3> normals;
+    std::vector<std::uint8_t> dirty;
+    bool anyDirty = false;
+
+    void markDirty(int node)
+    {
+        dirty[node] = 1;
+        anyDirty = true;
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 64 bit FNV-1a. constexpr, so names written as "name"_u are hashed by the compiler.
+// Pass the hash of the text before to hash text in pieces.
+constexpr std::uint64_t fnv1a(const char *text, size_t length, std::uint64_t hash = 0xcbf29ce484222325ull)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash ^= std::uint8_t(text[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// a uniform name reduced to its hash, see Shader's setters
+struct UniformName {
+    std::uint64_t hash;
+};
+
+// "pointLight.position"_u. Assign it to a constexpr UniformName to be certain no hashing is left for run time.
+constexpr UniformName operator"" _u(const char *name, size_t length)
+{
+    return UniformName{ fnv1a(name, length) };
+}
+
+// Uniform locations by name hash in one flat array, open addressing with linear probing and at most half full,
+// so a lookup is a mask of the hash and usually a single compare.
+class UniformTable {
+public:
+    void clear()
+    {
+        slots.assign(MIN_CAPACITY, Slot());
+        count = 0;
+    }
+
+    // false if a different location is already stored under hash, two names colliding
+    bool insert(std::uint64_t hash, int location)
+    {
+        if (slots.empty()) clear();
+        if ((count + 1) * 2 > slots.size()) grow();
+        Slot &slot = probe(hash);
+        if (slot.used) return slot.location == location;
+        slot.used = true;
+        slot.hash = hash;
+        slot.location = location;
+        count++;
+        return true;
+    }
+
+    // -1 for names the program has no active uniform for, which glUniform* ignores like an unknown name
+    int find(std::uint64_t hash) const
+    {
+        if (slots.empty()) return -1;
+        size_t mask = slots.size() - 1;
+        for (size_t i = size_t(hash) & mask;; i = (i + 1) & mask) {
+            const Slot &slot = slots[i];
+            if (!slot.used) return -1;
+            if (slot.hash == hash) return slot.location;
+        }
+    }
+
+    size_t size() const { return count; }
+
+private:
+    constexpr static size_t MIN_CAPACITY = 16;
+
+    struct Slot {
+        std::uint64_t hash = 0;
+        int location = -1;
+        bool used = false;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    Slot &probe(std::uint64_t hash)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = size_t(hash) & mask;
+        while (slots[i].used && slots[i].hash != hash)
+            i = (i + 1) & mask;
+        return slots[i];
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        for (const Slot &slot : old)
+            if (slot.used) probe(slot.hash) = slot;
+    }
+};
+
+#endif
@@ -7,165 +7,734 @@
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
+#include <array>
 #include <map>
+#include <memory>
 #include <numeric>
 #include <fstream>
 #include <sstream>
+#include <future>
+#include <chrono>
+#include <climits>
+#include <unordered_map>
+#include <sys/stat.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "bvh.h"
+#include "asset_pack.h"
+#include "obj_loader.h"
+#include "transform.h"
+#include "animation.h"
+#include "texture_compressor.h"
+#include "gltf_loader.h"
+#include "uniform_table.h"
+#include "glsl_preprocessor.h"
+#include "file_watcher.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// Shadow copy of the GL state draws change most: the program, the vertex array, texture bindings per unit,
+// buffer bindings, and depth, stencil, blend and cull state. Setting what is already set skips the driver.
+// The shadow only knows what went through here, which is why the code in this tree uses these calls instead of
+// the gl* ones they mirror; call invalidate after GL calls from anywhere else. Assumes a single context.
+class GLState {
+public:
+    constexpr static GLuint MAX_TEXTURE_UNITS = 32;
+
+    struct Counters {
+        unsigned int issued = 0; // calls that reached the driver
+        unsigned int elided = 0; // calls that would have set what was set already
+    };
+
+    static void useProgram(GLuint program) {
+        if (set(state().program, program)) glUseProgram(program);
+    }
+
+    static void bindVertexArray(GLuint vertexArray) {
+        if (set(state().vertexArray, vertexArray)) glBindVertexArray(vertexArray);
+    }
+
+    static void activeTexture(GLenum unit) {
+        if (set(state().activeUnit, GLuint(unit - GL_TEXTURE0))) glActiveTexture(unit);
+    }
+
+    // binds to the active unit, like glBindTexture
+    static void bindTexture(GLenum target, GLuint texture) {
+        State &shadow = state();
+        int slot = textureSlot(target);
+        if (slot < 0 || !shadow.activeUnit.known || shadow.activeUnit.value >= MAX_TEXTURE_UNITS) {
+            counters().issued++;
+            glBindTexture(target, texture);
+        } else if (set(shadow.textures[shadow.activeUnit.value][slot], texture)) {
+            glBindTexture(target, texture);
+        }
+    }
+
+    // binds texture to unit, switching the active unit only when the binding changes
+    static void bindTextureUnit(GLuint unit, GLenum target, GLuint texture) {
+        State &shadow = state();
+        int slot = textureSlot(target);
+        if (slot >= 0 && unit < MAX_TEXTURE_UNITS && shadow.textures[unit][slot].known
+                && shadow.textures[unit][slot].value == texture) {
+            counters().elided += 2;
+            return;
+        }
+        activeTexture(GL_TEXTURE0 + unit);
+        bindTexture(target, texture);
+    }
+
+    // the element array buffer binding belongs to the vertex array, so it is always passed on
+    static void bindBuffer(GLenum target, GLuint buffer) {
+        int slot = bufferSlot(target);
+        if (slot < 0) {
+            counters().issued++;
+            glBindBuffer(target, buffer);
+        } else if (set(state().buffers[slot], buffer)) {
+            glBindBuffer(target, buffer);
+        }
+    }
+
+    // binds the indexed binding point, and like glBindBufferRange the general binding of target too
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        counters().issued++;
+        glBindBufferRange(target, index, buffer, offset, size);
+        int slot = bufferSlot(target);
+        if (slot >= 0) state().buffers[slot] = Cached<GLuint>{ buffer, true };
+    }
+
+    static void enable(GLenum capability) { setCapability(capability, true); }
+    static void disable(GLenum capability) { setCapability(capability, false); }
+
+    static void depthFunc(GLenum function) {
+        if (set(state().depthFunc, function)) glDepthFunc(function);
+    }
+
+    static void depthMask(GLboolean flag) {
+        if (set(state().depthMask, flag)) glDepthMask(flag);
+    }
+
+    static void stencilFunc(GLenum function, GLint reference, GLuint mask) {
+        if (set(state().stencilFunc, std::array<GLuint, 3>{ { function, GLuint(reference), mask } }))
+            glStencilFunc(function, reference, mask);
+    }
+
+    static void stencilOp(GLenum stencilFail, GLenum depthFail, GLenum pass) {
+        if (set(state().stencilOp, std::array<GLenum, 3>{ { stencilFail, depthFail, pass } }))
+            glStencilOp(stencilFail, depthFail, pass);
+    }
+
+    static void stencilMask(GLuint mask) {
+        if (set(state().stencilMask, mask)) glStencilMask(mask);
+    }
+
+    static void blendFunc(GLenum source, GLenum destination) {
+        if (set(state().blendFunc, std::array<GLenum, 2>{ { source, destination } }))
+            glBlendFunc(source, destination);
+    }
+
+    static void cullFace(GLenum mode) {
+        if (set(state().cullFace, mode)) glCullFace(mode);
+    }
+
+    // GL unbinds deleted objects, and a new object may get the name back, so the shadow forgets them too
+    static void deleteTextures(GLsizei count, const GLuint *textures) {
+        State &shadow = state();
+        for (GLsizei i = 0; i < count; i++)
+            for (auto &unit : shadow.textures)
+                for (Cached<GLuint> &binding : unit)
+                    unbind(binding, textures[i]);
+        glDeleteTextures(count, textures);
+    }
+
+    static void deleteBuffers(GLsizei count, const GLuint *buffers) {
+        for (GLsizei i = 0; i < count; i++)
+            for (Cached<GLuint> &binding : state().buffers)
+                unbind(binding, buffers[i]);
+        glDeleteBuffers(count, buffers);
+    }
+
+    static void deleteVertexArrays(GLsizei count, const GLuint *vertexArrays) {
+        for (GLsizei i = 0; i < count; i++)
+            unbind(state().vertexArray, vertexArrays[i]);
+        glDeleteVertexArrays(count, vertexArrays);
+    }
+
+    // forgets the whole shadow, the next call of each kind goes to the driver
+    static void invalidate() { state() = State(); }
+
+    // the calls of the frame so far
+    static const Counters &frame() { return counters(); }
+
+    // the calls of the frame that ends, the counters start over for the next
+    static Counters endFrame() {
+        Counters ended = counters();
+        counters() = Counters();
+        return ended;
+    }
+
+private:
+    template<typename T>
+    struct Cached {
+        T value;
+        bool known;
+    };
+
+    struct State {
+        Cached<GLuint> program{}, vertexArray{}, activeUnit{};
+        Cached<GLuint> textures[MAX_TEXTURE_UNITS][3]{}; // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP
+        Cached<GLuint> buffers[4]{};                     // see bufferSlot
+        Cached<bool> capabilities[4]{};                  // see capabilitySlot
+        Cached<GLenum> depthFunc{}, cullFace{};
+        Cached<GLboolean> depthMask{};
+        Cached<GLuint> stencilMask{};
+        Cached<std::array<GLuint, 3>> stencilFunc{};
+        Cached<std::array<GLenum, 3>> stencilOp{};
+        Cached<std::array<GLenum, 2>> blendFunc{};
+    };
+
+    static State &state() {
+        static State shadow;
+        return shadow;
+    }
+
+    static Counters &counters() {
+        static Counters frameCounters;
+        return frameCounters;
+    }
+
+    // true if the driver has to be called, after which current holds value
+    template<typename T>
+    static bool set(Cached<T> &current, const T &value) {
+        if (current.known && current.value == value) {
+            counters().elided++;
+            return false;
+        }
+        current.value = value;
+        current.known = true;
+        counters().issued++;
+        return true;
+    }
+
+    static void unbind(Cached<GLuint> &binding, GLuint name) {
+        if (binding.known && binding.value == name) binding.value = 0;
+    }
+
+    static void setCapability(GLenum capability, bool enabled) {
+        int slot = capabilitySlot(capability);
+        if (slot >= 0 && !set(state().capabilities[slot], enabled)) return;
+        if (slot < 0) counters().issued++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    static int textureSlot(GLenum target) {
+        switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        default: return -1;
+        }
+    }
+
+    static int bufferSlot(GLenum target) {
+        switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_COPY_READ_BUFFER: return 1;
+        case GL_COPY_WRITE_BUFFER: return 2;
+        case GL_UNIFORM_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+
+    static int capabilitySlot(GLenum capability) {
+        switch (capability) {
+        case GL_DEPTH_TEST: return 0;
+        case GL_STENCIL_TEST: return 1;
+        case GL_BLEND: return 2;
+        case GL_CULL_FACE: return 3;
+        default: return -1;
+        }
+    }
+};
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// the files of a shader program and the #defines selecting the variant built from them
+struct ShaderSource {
+    std::string vertexPath, fragmentPath;
+    std::string geometryPath; // empty for programs without a geometry shader
+    ShaderDefines defines;
+
+    // the same for the same files and defines, whatever order the defines are in
+    std::string key() const {
+        return vertexPath + "|" + fragmentPath + "|" + geometryPath + "|" + GlslPreprocessor::defineLines(defines);
+    }
+};
+
 class Shader {
 public:
     GLuint ID;
+    GLuint serial; // unique per Shader object, unlike ID which GL may hand out again after a program is deleted
+    GLuint revision = 0; // counts the rebuilds, state looked up for an older one must be looked up again
+
+    bool fromBinaryCache = false; // linked from a program binary of an earlier run instead of compiled
+    ShaderSource source; // what the program is built from, for rebuilds
+    std::vector<std::string> files; // every file that went into the program, includes too
+
+    // a shader stage from the preprocessor until it is linked
+    struct Stage {
+        GLenum type = 0;
+        const char *name = nullptr; // for error messages
+        std::string code;
+        std::vector<std::string> files; // source string numbers in the compiler's messages index these
+        GLuint id = 0;
+    };
 
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr) {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure e) {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        GLuint vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        GLuint geometry;
-        if(geometryPath != nullptr) {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(ShaderSource{ vertexPath, fragmentPath, geometryPath ? geometryPath : "", ShaderDefines() }) {}
+
+    // The sources go through GlslPreprocessor, so they may #include files and test the defines. With wait false
+    // the constructor returns while the driver may still be compiling, see isReady, and finish or use wait for it.
+    explicit Shader(const ShaderSource &source, bool wait = true) : serial(newSerial()), source(source) {
+        start();
+        if (wait)
+            finish();
+    }
+
+    // false while the driver is still compiling or linking the program in the background
+    bool isReady() const {
+        if (finished || stages.empty() || !parallelCompileSupported())
+            return true;
+        GLint done = GL_TRUE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // waits for compiling and linking, reports their errors and reads the uniforms
+    void finish() {
+        if (finished) return;
+        finished = true;
+        if (!stages.empty()) {
+            for (const Stage &stage : stages)
+                checkCompileErrors(stage.id, stage.name, stage.files);
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessery
+            for (const Stage &stage : stages)
+                glDeleteShader(stage.id);
+            stages.clear();
+            saveBinary(key);
+        }
+        loadUniforms();
+    }
 
+    // GL_KHR_parallel_shader_compile, or its ARB twin: compile and link calls return at once and the driver works on
+    // its own threads until someone asks for the result. Not in macOS' GL 4.1, where everything compiles in order.
+    static bool parallelCompileSupported() {
+        static int supported = -1;
+        if (supported < 0) {
+            bool khr = glfwExtensionSupported("GL_KHR_parallel_shader_compile");
+            supported = khr || glfwExtensionSupported("GL_ARB_parallel_shader_compile");
+            typedef void (*MaxShaderCompilerThreads)(GLuint);
+            auto maxThreads = supported ? reinterpret_cast<MaxShaderCompilerThreads>(glfwGetProcAddress(
+                                  khr ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB")) : nullptr;
+            if (maxThreads)
+                maxThreads(0xFFFFFFFF); // as many threads as the driver wants
+        }
+        return supported == 1;
+    }
+
+    // reads and preprocesses the stages of source. Touches no GL state, so it may run on any thread.
+    static bool preprocess(const ShaderSource &source, std::vector<Stage> &stages, std::string &error) {
+        const std::pair<GLenum, const char *> stageTypes[] = { { GL_VERTEX_SHADER, "VERTEX" },
+                                                               { GL_FRAGMENT_SHADER, "FRAGMENT" },
+                                                               { GL_GEOMETRY_SHADER, "GEOMETRY" } };
+        const std::string *paths[] = { &source.vertexPath, &source.fragmentPath, &source.geometryPath };
+        bool read = true;
+        stages.clear();
+        for (int i = 0; i < 3; i++) {
+            if (paths[i]->empty()) continue;
+            stages.emplace_back();
+            stages.back().type = stageTypes[i].first;
+            stages.back().name = stageTypes[i].second;
+            std::string stageError;
+            if (!GlslPreprocessor::process(*paths[i], source.defines, stages.back().code, stages.back().files, stageError)) {
+                error += (read ? "" : "\n") + stageError;
+                read = false;
+            }
+        }
+        return read;
+    }
+
+    // Builds the program again from freshly preprocessed stages, see ShaderReloader. Waits for the compiler.
+    // ID switches to the new program only once it linked, taking the values of the uniforms along; otherwise
+    // the errors are printed and the old program stays.
+    bool rebuild(std::vector<Stage> newStages) {
+        finish();
+        GLuint program = glCreateProgram();
+        compile(program, newStages);
+        bool built = true;
+        for (const Stage &stage : newStages)
+            built = checkCompileErrors(stage.id, stage.name, stage.files) && built;
+        built = built && checkCompileErrors(program, "PROGRAM");
+        for (const Stage &stage : newStages)
+            glDeleteShader(stage.id);
+        if (!built) {
+            glDeleteProgram(program);
+            return false;
+        }
+        copyUniforms(ID, program);
+        glDeleteProgram(ID);
+        ID = program;
+        revision++; // tables of the old program are built again, new samplers included
+        fromBinaryCache = false;
+        files = stageFiles(newStages);
+        samplerSlots.erase(std::remove_if(samplerSlots.begin(), samplerSlots.end(),
+                                          [](const SamplerSlot &slot) { return slot.unit < 0; }), samplerSlots.end());
+        loadUniforms();
+        return true;
+    }
+
+    // Directory linked programs are kept in as binaries, keyed by their sources and the driver. Created on
+    // first use, set it to "" before creating shaders to always compile from source.
+    static std::string &binaryCacheDirectory() {
+        static std::string directory = "shadercache";
+        return directory;
     }
 
     void use(){
-        glUseProgram(ID);
+        finish();
+        GLState::useProgram(ID);
+    }
+
+    // The string setters hash the name and look it up in the table of the program's active uniforms.
+    // Hot paths pass "name"_u instead, which the compiler has already hashed.
+    GLint location(const std::string &name) const {
+        return uniforms.find(fnv1a(name.data(), name.size()));
+    }
+    GLint location(UniformName name) const {
+        return uniforms.find(name.hash);
     }
 
-    void setBool(const std::string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+    void setBool(const std::string &name, bool value) const { setBool(UniformName{ hash(name) }, value); }
+    void setBool(UniformName name, bool value) const {
+        glUniform1i(location(name), static_cast<int>(value));
     }
 
-    void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setInt(const std::string &name, int value) const { setInt(UniformName{ hash(name) }, value); }
+    void setInt(UniformName name, int value) const {
+        glUniform1i(location(name), value);
     }
 
-    void setFloat(const std::string &name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setFloat(const std::string &name, float value) const { setFloat(UniformName{ hash(name) }, value); }
+    void setFloat(UniformName name, float value) const {
+        glUniform1f(location(name), value);
     }
 
-    void setVec2(const std::string &name, const glm::vec2 &value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(UniformName{ hash(name) }, value); }
+    void setVec2(UniformName name, const glm::vec2 &value) const {
+        glUniform2fv(location(name), 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    void setVec2(const std::string &name, float x, float y) const { setVec2(UniformName{ hash(name) }, x, y); }
+    void setVec2(UniformName name, float x, float y) const {
+        glUniform2f(location(name), x, y);
     }
-    void setDVec2(const std::string &name, const glm::dvec2 &vec) const {
-        glUniform2dv(glGetUniformLocation(ID, name.c_str()), 1, &vec[0]);
+    void setDVec2(const std::string &name, const glm::dvec2 &vec) const { setDVec2(UniformName{ hash(name) }, vec); }
+    void setDVec2(UniformName name, const glm::dvec2 &vec) const {
+        glUniform2dv(location(name), 1, &vec[0]);
     }
 
 
-    void setVec3(const std::string &name, const glm::vec3 &value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(UniformName{ hash(name) }, value); }
+    void setVec3(UniformName name, const glm::vec3 &value) const {
+        glUniform3fv(location(name), 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    void setVec3(const std::string &name, float x, float y, float z) const { setVec3(UniformName{ hash(name) }, x, y, z); }
+    void setVec3(UniformName name, float x, float y, float z) const {
+        glUniform3f(location(name), x, y, z);
     }
 
-    void setVec4(const std::string &name, const glm::vec4 &value) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(UniformName{ hash(name) }, value); }
+    void setVec4(UniformName name, const glm::vec4 &value) const {
+        glUniform4fv(location(name), 1, &value[0]);
+    }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const { setVec4(UniformName{ hash(name) }, x, y, z, w); }
+    void setVec4(UniformName name, float x, float y, float z, float w) const {
+        glUniform4f(location(name), x, y, z, w);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(UniformName{ hash(name) }, mat); }
+    void setMat2(UniformName name, const glm::mat2 &mat) const {
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
-    void setMat2(const std::string &name, const glm::mat2 &mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(UniformName{ hash(name) }, mat); }
+    void setMat3(UniformName name, const glm::mat3 &mat) const {
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
-    void setMat3(const std::string &name, const glm::mat3 &mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(UniformName{ hash(name) }, mat); }
+    void setMat4(UniformName name, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
-    void setMat4(const std::string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    void setDMat4(const std::string &name, const glm::dmat4 &mat) const { setDMat4(UniformName{ hash(name) }, mat); }
+    void setDMat4(UniformName name, const glm::dmat4 &mat) const {
+        glUniformMatrix4dv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
-    void setDMat4(const std::string &name, const glm::dmat4 &mat) const {
-        glUniformMatrix4dv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    // texture unit the sampler uniform reads from, -1 if the program has no such sampler. Units are handed out
+    // in order of first request and set in the program once, so the same sampler always uses the same unit.
+    GLint samplerUnit(const std::string &name) {
+        for (const SamplerSlot &slot : samplerSlots)
+            if (slot.name == name)
+                return slot.unit;
+        GLint samplerLocation = location(name);
+        GLint unit = -1;
+        if (samplerLocation >= 0) {
+            unit = nextSamplerUnit++;
+            glProgramUniform1i(ID, samplerLocation, unit);
+        }
+        samplerSlots.push_back({ name, unit });
+        return unit;
     }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    std::vector<Stage> stages;
+    std::uint64_t key = 0;
+    bool finished = false;
+
+    struct SamplerSlot {
+        std::string name;
+        GLint unit;
+    };
+    std::vector<SamplerSlot> samplerSlots;
+    GLint nextSamplerUnit = 0;
+    UniformTable uniforms;
+
+    static std::uint64_t hash(const std::string &name) {
+        return fnv1a(name.data(), name.size());
+    }
+
+    // the locations of every active uniform outside a block, by name hash. Array elements go in under every name
+    // GL accepts for them: "a", "a[0]", "a[1]"...
+    void loadUniforms() {
+        uniforms.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, GLuint(i), GLsizei(buffer.size()), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0) continue; // in a uniform block
+            addUniform(name, location);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                addUniform(base, location);
+                for (GLint element = 1; element < size; element++) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+        }
+    }
+
+    // file header of a cached program binary, the key guards against hash collisions of the file name
+    struct BinaryHeader {
+        std::uint32_t magic;
+        std::uint32_t format;
+        std::uint64_t key;
+    };
+    constexpr static std::uint32_t BINARY_MAGIC = 0x4e494250; // "PBIN"
+
+    // hash of the preprocessed sources and of everything about the driver that can make an old binary invalid
+    static std::uint64_t binaryKey(const std::vector<Stage> &stages) {
+        std::uint64_t key = fnv1a("", 0);
+        for (const Stage &stage : stages) {
+            key = fnv1a(reinterpret_cast<const char *>(&stage.type), sizeof(stage.type), key);
+            key = fnv1a(stage.code.data(), stage.code.size(), key);
+            key = fnv1a("", 1, key); // a separator, so text moving between the stages changes the key
+        }
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION }) {
+            const char *text = reinterpret_cast<const char *>(glGetString(name));
+            if (text) key = fnv1a(text, std::strlen(text) + 1, key);
+        }
+        return key;
+    }
+
+    // preprocesses the stages, then links ID from a cached binary or starts compiling and linking it
+    void start() {
+        std::string error;
+        if (!preprocess(source, stages, error))
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << error << std::endl;
+        files = stageFiles(stages);
+        // a program binary from an earlier run with the same sources and driver skips compiling and linking
+        key = binaryKey(stages);
+        ID = glCreateProgram();
+        if (loadBinary(key)) {
+            fromBinaryCache = true;
+            stages.clear();
+            return;
+        }
+        compile(ID, stages);
+    }
+
+    // starts compiling the stages and linking them into program, which returns at once where compiling is parallel
+    static void compile(GLuint program, std::vector<Stage> &stages) {
+        for (Stage &stage : stages) {
+            const char *code = stage.code.c_str();
+            GLint length = GLint(stage.code.size());
+            stage.id = glCreateShader(stage.type);
+            glShaderSource(stage.id, 1, &code, &length);
+            glCompileShader(stage.id);
+            glAttachShader(program, stage.id);
+        }
+        if (!binaryCacheDirectory().empty())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+    }
+
+    static std::vector<std::string> stageFiles(const std::vector<Stage> &stages) {
+        std::vector<std::string> names;
+        for (const Stage &stage : stages)
+            for (const std::string &file : stage.files)
+                if (std::find(names.begin(), names.end(), file) == names.end())
+                    names.push_back(file);
+        return names;
+    }
+
+    // carries the values of the uniforms both programs have over to program to, so what was set once at setup
+    // survives a rebuild. The value is read as the type it has in to, which GL converts to.
+    static void copyUniforms(GLuint from, GLuint to) {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(to, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(to, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(to, GLuint(i), GLsizei(buffer.size()), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            bool array = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+            for (GLint element = 0; element < size; element++) {
+                std::string elementName = array ? name.substr(0, name.size() - 3) + "[" + std::to_string(element) + "]" : name;
+                GLint source = glGetUniformLocation(from, elementName.c_str());
+                GLint target = glGetUniformLocation(to, elementName.c_str());
+                if (source >= 0 && target >= 0)
+                    copyUniform(from, source, to, target, type);
+            }
+        }
+    }
+
+    static void copyUniform(GLuint from, GLint source, GLuint to, GLint target, GLenum type) {
+        GLfloat f[16];
+        GLdouble d[16];
+        GLint n[4];
+        switch (type) {
+        case GL_FLOAT: glGetUniformfv(from, source, f); glProgramUniform1fv(to, target, 1, f); break;
+        case GL_FLOAT_VEC2: glGetUniformfv(from, source, f); glProgramUniform2fv(to, target, 1, f); break;
+        case GL_FLOAT_VEC3: glGetUniformfv(from, source, f); glProgramUniform3fv(to, target, 1, f); break;
+        case GL_FLOAT_VEC4: glGetUniformfv(from, source, f); glProgramUniform4fv(to, target, 1, f); break;
+        case GL_FLOAT_MAT2: glGetUniformfv(from, source, f); glProgramUniformMatrix2fv(to, target, 1, GL_FALSE, f); break;
+        case GL_FLOAT_MAT3: glGetUniformfv(from, source, f); glProgramUniformMatrix3fv(to, target, 1, GL_FALSE, f); break;
+        case GL_FLOAT_MAT4: glGetUniformfv(from, source, f); glProgramUniformMatrix4fv(to, target, 1, GL_FALSE, f); break;
+        case GL_DOUBLE: glGetUniformdv(from, source, d); glProgramUniform1dv(to, target, 1, d); break;
+        case GL_DOUBLE_VEC2: glGetUniformdv(from, source, d); glProgramUniform2dv(to, target, 1, d); break;
+        case GL_DOUBLE_MAT4: glGetUniformdv(from, source, d); glProgramUniformMatrix4dv(to, target, 1, GL_FALSE, d); break;
+        case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, source, n); glProgramUniform2iv(to, target, 1, n); break;
+        case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, source, n); glProgramUniform3iv(to, target, 1, n); break;
+        case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, source, n); glProgramUniform4iv(to, target, 1, n); break;
+        default: glGetUniformiv(from, source, n); glProgramUniform1iv(to, target, 1, n); break; // int, bool, samplers
+        }
+    }
+
+    static std::string binaryPath(std::uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(key));
+        return binaryCacheDirectory() + name;
+    }
+
+    static bool driverSupportsBinaries() {
+        static GLint formats = -1;
+        if (formats < 0)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // links ID from the cached binary, false if there is none or the driver rejects it
+    bool loadBinary(std::uint64_t key) {
+        if (binaryCacheDirectory().empty() || !driverSupportsBinaries()) return false;
+        MappedFile file(binaryPath(key));
+        BinaryHeader header;
+        if (!file.isOpen() || file.length() <= sizeof(header)) return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != BINARY_MAGIC || header.key != key) return false;
+        glProgramBinary(ID, header.format, file.data() + sizeof(header), GLsizei(file.length() - sizeof(header)));
+        GLint linked = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    // writes the linked program, to a temporary file first so no other process reads it half written
+    void saveBinary(std::uint64_t key) const {
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (binaryCacheDirectory().empty() || !driverSupportsBinaries() || linked != GL_TRUE) return;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        std::vector<char> binary(length);
+        BinaryHeader header = { BINARY_MAGIC, 0, key };
+        GLenum format;
+        glGetProgramBinary(ID, length, &length, &format, binary.data());
+        header.format = format;
+        mkdir(binaryCacheDirectory().c_str(), 0755);
+        std::string path = binaryPath(key), temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(binary.data(), length);
+        out.close();
+        if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::cout << "ERROR::SHADER::BINARY_CACHE_WRITE " << path << std::endl;
+            std::remove(temporary.c_str());
+        }
+    }
+
+    void addUniform(const std::string &name, GLint location) {
+        if (!uniforms.insert(hash(name), location))
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << name << std::endl;
+    }
+
+    static GLuint newSerial() {
+        static GLuint next = 0;
+        return ++next;
+    }
+
+    // utility function for checking shader compilation/linking errors, false if there were any.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type) {
+    bool checkCompileErrors(GLuint shader, std::string type, const std::vector<std::string> &files = {}) {
         GLint success;
         GLchar infoLog[1024];
         if(type != "PROGRAM") {
@@ -173,6 +742,8 @@ private:
             if(!success) {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
                 std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << std::endl;
+                for (size_t i = 0; i < files.size(); i++) // what the source string numbers in the log stand for
+                    std::cout << "  " << i << ": " << files[i] << std::endl;
             }
         }
         else {
@@ -182,7 +753,92 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
             }
         }
+        return success == GL_TRUE;
+    }
+};
+
+// Programs by ShaderSource::key, each variant compiled once. prepare starts every variant it is given before
+// waiting for any, so a driver compiling in parallel builds them side by side; get waits for one.
+class ShaderVariants {
+public:
+    void prepare(const std::vector<ShaderSource> &sources) {
+        for (const ShaderSource &source : sources)
+            start(source);
+    }
+
+    Shader &get(const ShaderSource &source) {
+        Shader &shader = start(source);
+        shader.finish();
+        return shader;
+    }
+
+    size_t size() const { return shaders.size(); }
+
+private:
+    std::map<std::string, std::unique_ptr<Shader>> shaders;
+
+    Shader &start(const ShaderSource &source) {
+        std::unique_ptr<Shader> &shader = shaders[source.key()];
+        if (!shader)
+            shader.reset(new Shader(source, false));
+        return *shader;
+    }
+};
+
+// Rebuilds the watched shaders when a file they are built from changes, to edit shaders while a demo runs.
+// A worker thread reads and preprocesses the files; update, once per frame, compiles what is ready and swaps it
+// in, see Shader::rebuild. Files served from a mounted asset pack never change, so this is for loose files.
+class ShaderReloader {
+public:
+    explicit ShaderReloader(const std::vector<std::string> &directories = { "shaders" }) : watcher(directories) {}
+
+    // the shader must live as long as the reloader
+    void watch(Shader &shader) {
+        watched.emplace_back();
+        watched.back().shader = &shader;
+    }
+
+    // at a frame boundary with the GL context current, before the shaders are used. Never waits for a file, only
+    // for compiling a program whose files were read.
+    void update() {
+        std::vector<std::string> changed = watcher.changes();
+        for (Watched &entry : watched) {
+            for (const std::string &file : changed)
+                if (std::find(entry.shader->files.begin(), entry.shader->files.end(), file) != entry.shader->files.end())
+                    entry.dirty = true;
+            if (entry.read.valid() && entry.read.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                Preprocessed result = entry.read.get();
+                if (!result.read)
+                    std::cout << "ERROR::SHADER::RELOAD " << result.error << std::endl;
+                else if (entry.shader->rebuild(std::move(result.stages)))
+                    std::cout << "Reloaded " << entry.shader->source.fragmentPath << std::endl;
+            }
+            if (entry.dirty && !entry.read.valid()) { // a change during a read starts another once it is done
+                entry.dirty = false;
+                ShaderSource source = entry.shader->source;
+                entry.read = std::async(std::launch::async, [source]() {
+                    Preprocessed result;
+                    result.read = Shader::preprocess(source, result.stages, result.error);
+                    return result;
+                });
+            }
+        }
     }
+
+private:
+    struct Preprocessed {
+        std::vector<Shader::Stage> stages;
+        bool read;
+        std::string error;
+    };
+    struct Watched {
+        Shader *shader;
+        bool dirty = false;
+        std::future<Preprocessed> read;
+    };
+
+    FileWatcher watcher;
+    std::vector<Watched> watched;
 };
 
 class View2D {
@@ -354,9 +1010,16 @@ private:
     }
 };
 
+// stbi_load through an AssetFile, images in the mounted asset pack are decoded without a copy
+unsigned char *loadImage(const std::string &path, int *width, int *height, int *channels) {
+    AssetFile file(path);
+    if (!file.isOpen() || file.length() == 0) return nullptr;
+    return stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(file.data()), int(file.length()), width, height, channels, 0);
+}
+
 void loadTexture(const char *location, GLuint &texture, bool flip) {
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    GLState::bindTexture(GL_TEXTURE_2D, texture);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // set texture wrapping options
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -368,7 +1031,7 @@ void loadTexture(const char *location, GLuint &texture, bool flip) {
         stbi_set_flip_vertically_on_load(true);
     else
         stbi_set_flip_vertically_on_load(false);
-    unsigned char *data = stbi_load(location, &texWidth, &texHeight, &nrChannels, 0);
+    unsigned char *data = loadImage(location, &texWidth, &texHeight, &nrChannels);
     if (data) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
@@ -392,98 +1055,358 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// up to 4 bones moving a vertex and their weights out of 255. Only skinned meshes have them, in a vertex
+// stream of their own next to either vertex format.
+struct VertexSkin {
+    GLubyte BoneIds[4] = { 0, 0, 0, 0 };
+    GLubyte BoneWeights[4] = { 0, 0, 0, 0 };
+};
+
+enum VertexFormat {
+    VERTEX_FULL,   // plain Vertex, 56 bytes
+    VERTEX_PACKED  // quantized PackedVertex, 20 bytes
+};
+
+// Compact GPU-side vertex. The bitangent is rebuilt in the shader as sign * cross(normal, tangent).
+struct PackedVertex {
+    // position normalized to the mesh AABB, w holds the bitangent sign (0 or 65535)
+    GLushort Position[4];
+    // octahedral encoded normal and tangent
+    GLshort Normal[2];
+    GLshort Tangent[2];
+    // half float texCoords
+    GLushort TexCoords[2];
+};
+
+// float to IEEE half, round to nearest
+inline GLushort packHalf(float value) {
+    GLuint bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    GLuint sign = (bits >> 16) & 0x8000u;
+    GLint exponent = GLint((bits >> 23) & 0xff) - 127 + 15;
+    GLuint mantissa = bits & 0x7fffffu;
+
+    if (exponent >= 31) // overflow, infinity or nan
+        return GLushort(sign | 0x7c00u | (((bits & 0x7fffffffu) > 0x7f800000u) ? 0x200u : 0u));
+    if (exponent <= 0) { // subnormal or zero
+        if (exponent < -10)
+            return GLushort(sign);
+        mantissa |= 0x800000u;
+        GLuint shift = GLuint(14 - exponent);
+        GLuint half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1u) half++;
+        return GLushort(sign | half);
+    }
+    GLuint half = sign | (GLuint(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u) half++; // carry may roll into the exponent, which is still correct
+    return GLushort(half);
+}
+
+// octahedral mapping of a unit vector to snorm16 pair
+inline void packOctahedral(glm::vec3 n, GLshort out[2]) {
+    float norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (norm == 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    n /= norm;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        p.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    out[0] = GLshort(std::round(glm::clamp(p.x, -1.0f, 1.0f) * 32767.0f));
+    out[1] = GLshort(std::round(glm::clamp(p.y, -1.0f, 1.0f) * 32767.0f));
+}
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
+    GLenum target = GL_TEXTURE_2D; // GL_TEXTURE_2D_ARRAY once packed, see ModelOptions::textureArrays
 };
 
-class Mesh {
-public:
-    /*  Mesh Data  */
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-    GLuint VAO;
+// a range of the mesh element buffer
+struct MeshLod {
+    GLuint firstIndex;
+    GLuint indexCount;
+    float error; // simplification error in mesh units, 0 for the full mesh
+};
 
-    /*  Functions  */
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+// the six clip planes of a view projection matrix, normals point inwards
+struct Frustum {
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    Frustum(const glm::mat4 &viewProjection)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        // plane = row 3 +- row i of the matrix (Gribb and Hartmann), glm is column major
+        for (int i = 0; i < 3; i++) {
+            for (int c = 0; c < 4; c++) {
+                planes[2 * i][c]     = viewProjection[c][3] + viewProjection[c][i];
+                planes[2 * i + 1][c] = viewProjection[c][3] - viewProjection[c][i];
+            }
+        }
+        for (glm::vec4 &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    bool intersectsSphere(glm::vec3 center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
     }
 
-    // render the mesh
-    void Draw(Shader shader)
-    {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-                                                     // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    // box given by its center and half extent
+    bool intersectsBox(glm::vec3 center, glm::vec3 extent) const
+    {
+        for (const glm::vec4 &plane : planes) {
+            glm::vec3 normal(plane);
+            float reach = glm::dot(glm::abs(normal), extent);
+            if (glm::dot(normal, center) + plane.w < -reach)
+                return false;
         }
+        return true;
+    }
+};
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+// camera parameters for screen space decisions in Model::Draw
+struct ViewInfo {
+    glm::vec3 position; // camera position in world space
+    float lodScale;     // pixels covered by one unit at distance one
+    float pixelError;   // simplification error tolerated on screen, in pixels
+    Frustum frustum;    // world space
+    glm::mat3 rotation; // of the view, turns world space normal matrices into view space ones
+
+    ViewInfo(const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight, float pixelError = 1.0f)
+        : position(glm::vec3(glm::inverse(view)[3])), lodScale(projection[1][1] * viewportHeight * 0.5f),
+          pixelError(pixelError), frustum(projection * view), rotation(view) {}
+};
+
+// closest hit of Model::raycast
+struct ModelHit {
+    float t = FLT_MAX;     // distance along the ray in units of its direction
+    GLuint mesh = ~0u;     // index into Model::meshes, ~0u for a miss
+    GLuint triangle = ~0u; // triangle number in the mesh's indices
+    glm::vec3 position;    // world space hit point
+
+    bool hit() const { return mesh != ~0u; }
+};
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+// what Model::Draw did with the meshes it was given
+struct DrawStats {
+    GLuint drawn = 0;
+    GLuint culled = 0;
+    GLuint clustersDrawn = 0;  // with ModelOptions::clusterCulling
+    GLuint clustersCulled = 0;
+    GLuint drawCalls = 0;      // multi-draws issued
+};
+
+// Owns one GL object name and deletes it with the matching glDelete* call. Movable, not copyable.
+template<typename Traits>
+class GLObject {
+public:
+    GLObject() : id(0) {}
+    explicit GLObject(GLuint id) : id(id) {}
+    ~GLObject() { reset(); }
+
+    GLObject(GLObject &&other) noexcept : id(other.id) { other.id = 0; }
+    GLObject &operator=(GLObject &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+    GLObject(const GLObject &) = delete;
+    GLObject &operator=(const GLObject &) = delete;
+
+    static GLObject create() { return GLObject(Traits::create()); }
+    operator GLuint() const { return id; }
+
+    void reset()
+    {
+        if (id) Traits::destroy(id);
+        id = 0;
     }
 
 private:
-    /*  Render data  */
-    GLuint VBO, EBO;
+    GLuint id;
+};
 
-    /*  Functions    */
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+struct GLBufferTraits {
+    static GLuint create() { GLuint id; glGenBuffers(1, &id); return id; }
+    static void destroy(GLuint id) { GLState::deleteBuffers(1, &id); }
+};
+
+struct GLVertexArrayTraits {
+    static GLuint create() { GLuint id; glGenVertexArrays(1, &id); return id; }
+    static void destroy(GLuint id) { GLState::deleteVertexArrays(1, &id); }
+};
+
+typedef GLObject<GLBufferTraits> GLBuffer;
+typedef GLObject<GLVertexArrayTraits> GLVertexArray;
+
+// Vertex and element storage shared by many meshes. Each mesh is appended at a base vertex and a first index,
+// so a whole model (or several models of one vertex format) draws from a single VAO.
+// The buffers grow by copying on the GPU, no CPU side copy is kept.
+class GeometryBuffer {
+public:
+    GLVertexArray VAO;
+    VertexFormat format;
+
+    GeometryBuffer(VertexFormat format = VERTEX_FULL)
+        : VAO(GLVertexArray::create()), format(format), generation(0),
+          vertexCount(0), indexCount(0), vertexCapacity(0), indexCapacity(0), layerCapacity(0), skinCapacity(0) {}
+
+    GLsizeiptr vertexSize() const { return format == VERTEX_PACKED ? sizeof(PackedVertex) : sizeof(Vertex); }
+
+    // appends count vertices of this buffer's format and returns the base vertex they start at.
+    // Attribute 7 of each of them is layer, the texture array layer of the mesh's material.
+    // skins, one per vertex, go to attributes 5 and 6; null for rigid meshes.
+    GLint appendVertices(const void *data, GLuint count, GLushort layer = 0, const VertexSkin *skins = nullptr)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        GLint baseVertex = vertexCount;
+        if (count == 0) return baseVertex;
+        bool moved = reserve(VBO, vertexCount * vertexSize(), (vertexCount + count) * vertexSize(), vertexCapacity);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, vertexCount * vertexSize(), count * vertexSize(), data);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (layer != 0) {
+            vector<GLushort> layers(count, layer);
+            moved |= appendStream(layerVBO, layerCapacity, sizeof(GLushort), layers.data(), count);
+        } else if (hasLayers())
+            moved |= appendStream(layerVBO, layerCapacity, sizeof(GLushort), nullptr, count);
+        if (skins || hasSkins())
+            moved |= appendStream(skinVBO, skinCapacity, sizeof(VertexSkin), skins, count);
+        vertexCount += count;
+        if (moved) {
+            setupVertexArray(VAO, EBO);
+            generation++;
+        }
+        return baseVertex;
+    }
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    // appends count indices and returns the position of the first one
+    GLuint appendIndices(const unsigned int *data, GLuint count)
+    {
+        GLuint firstIndex = indexCount;
+        if (count == 0) return firstIndex;
+        GLsizeiptr indexSize = sizeof(unsigned int);
+        bool moved = reserve(EBO, indexCount * indexSize, (indexCount + count) * indexSize, indexCapacity);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexCount * indexSize, count * indexSize, data);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        indexCount += count;
+        // without a vertex buffer there is nothing to point the attributes at yet, the first
+        // appendVertices sets the VAO up with this EBO
+        if (moved && vertexCapacity > 0) setupVertexArray(VAO, EBO);
+        return firstIndex;
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    // changes whenever the vertex buffer object is replaced, so VAOs made by setupVertexArray must be refreshed
+    GLuint vertexGeneration() const { return generation; }
 
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // the layer stream only exists once a mesh on a texture array layer other than 0 is appended,
+    // until then attribute 7 is the constant 0
+    bool hasLayers() const { return layerCapacity > 0; }
+
+    // the same for the skin stream and the first skinned mesh, attributes 5 and 6 are 0 until then
+    bool hasSkins() const { return skinCapacity > 0; }
+
+    // points vertexArray at this buffer's vertices and the given element buffer
+    void setupVertexArray(GLuint vertexArray, GLuint elementBuffer) const
+    {
+        GLState::bindVertexArray(vertexArray);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (format == VERTEX_PACKED)
+            setupPacked();
+        else
+            setupFull();
+        // bone ids and weights
+        if (hasSkins()) {
+            GLState::bindBuffer(GL_ARRAY_BUFFER, skinVBO);
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(VertexSkin), (void*)offsetof(VertexSkin, BoneIds));
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexSkin), (void*)offsetof(VertexSkin, BoneWeights));
+        } else {
+            // zero weights, which skinning.vs.glsl treats as rigid. Context state like attribute 7's below.
+            glDisableVertexAttribArray(5);
+            glVertexAttribI4ui(5, 0, 0, 0, 0);
+            glDisableVertexAttribArray(6);
+            glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+        // material layer, a separate stream so the vertex layouts stay as they are
+        if (hasLayers()) {
+            GLState::bindBuffer(GL_ARRAY_BUFFER, layerVBO);
+            glEnableVertexAttribArray(7);
+            glVertexAttribIPointer(7, 1, GL_UNSIGNED_SHORT, sizeof(GLushort), (void*)0);
+        } else {
+            // the current value is context state rather than VAO state, but no other attribute 7 sets it
+            glDisableVertexAttribArray(7);
+            glVertexAttribI1ui(7, 0);
+        }
+        GLState::bindVertexArray(0);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    GLBuffer VBO, EBO, layerVBO, skinVBO;
+    GLuint generation;
+    GLuint vertexCount, indexCount;
+    GLsizeiptr vertexCapacity, indexCapacity, layerCapacity, skinCapacity; // in bytes
+
+    // writes count elements of size bytes for the vertices after vertexCount to an optional stream, zeros if
+    // data is null. The vertices before them get zeros when this creates the stream. Returns true if the
+    // buffer object was replaced.
+    bool appendStream(GLBuffer &buffer, GLsizeiptr &capacity, GLsizeiptr size, const void *data, GLuint count)
+    {
+        GLuint first = capacity > 0 ? vertexCount : 0;
+        bool moved = reserve(buffer, first * size, (vertexCount + count) * size, capacity);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        GLuint zeroEnd = data ? vertexCount : vertexCount + count;
+        if (zeroEnd > first) {
+            vector<char> zeros((zeroEnd - first) * size, 0);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, first * size, zeros.size(), zeros.data());
+        }
+        if (data)
+            glBufferSubData(GL_COPY_WRITE_BUFFER, vertexCount * size, count * size, data);
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return moved;
+    }
+
+    // makes room for needed bytes, doubling the capacity. Returns true if the buffer object was replaced.
+    static bool reserve(GLBuffer &buffer, GLsizeiptr used, GLsizeiptr needed, GLsizeiptr &capacity)
+    {
+        if (needed <= capacity) return false;
+        GLsizeiptr grown = std::max(needed, capacity * 2);
+        GLBuffer replacement = GLBuffer::create();
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+        glBufferData(GL_COPY_WRITE_BUFFER, grown, NULL, GL_STATIC_DRAW);
+        if (used > 0) {
+            GLState::bindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            GLState::bindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        GLState::bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = std::move(replacement); // deletes the old buffer
+        capacity = grown;
+        return true;
+    }
+
+    void setupFull() const
+    {
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
         // vertex normals
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
@@ -496,58 +1419,1192 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    }
+
+    // see model_packed.vs.glsl for the matching decode
+    void setupPacked() const
+    {
+        // vertex positions (+ bitangent sign)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+    }
+};
+
+class Mesh {
+public:
+    /*  Mesh Data  */
+    vector<Vertex> vertices;
+    vector<VertexSkin> skins;        // per vertex for skinned meshes, empty for rigid ones
+    vector<unsigned int> indices;
+    vector<Texture> textures;
+    vector<unsigned int> lodIndices; // simplified levels, stored after indices in the element buffer
+    vector<MeshLod> lods;            // lods[0] is the full mesh, relative to firstIndex
+    vector<Meshlet> meshlets;        // clusters of the full mesh for culling, relative to firstIndex
+    VertexFormat format;
+    glm::vec3 aabbMin, aabbMax;
+    glm::vec3 sphereCenter;          // bounding sphere
+    float sphereRadius;
+    glm::vec3 packMin, packExtent;   // range the packed positions are normalized to
+    BVH bvh;                         // for ray queries, empty unless buildBvh was called
+    GLuint VAO;
+    GLint baseVertex;                // where the mesh lives in its GeometryBuffer
+    GLuint firstIndex;
+    GLuint node;                     // the Model::transforms node the mesh is placed by
+    GLushort materialLayer;          // layer of the textures if they are arrays, the vertices carry it to the shader
+
+    /*  Functions  */
+    // constructor, lods index into lodIndices. The mesh is drawable once it has been uploaded.
+    // Takes the vectors by value, pass them with std::move to avoid copying the mesh data.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         vector<unsigned int> lodIndices = vector<unsigned int>(), vector<MeshLod> lods = vector<MeshLod>(),
+         vector<Meshlet> meshlets = vector<Meshlet>(), vector<VertexSkin> skins = vector<VertexSkin>())
+        : vertices(std::move(vertices)), skins(std::move(skins)), indices(std::move(indices)), textures(std::move(textures)),
+          lodIndices(std::move(lodIndices)), meshlets(std::move(meshlets)), format(VERTEX_FULL), VAO(0), baseVertex(0),
+          firstIndex(0), node(0), materialLayer(0)
+    {
+        this->lods.reserve(lods.size() + 1);
+        this->lods.push_back({ 0, GLuint(this->indices.size()), 0.0f });
+        for (MeshLod lod : lods) {
+            lod.firstIndex += this->indices.size();
+            this->lods.push_back(lod);
+        }
+
+        calculateBounds();
+        packMin = aabbMin;
+        packExtent = aabbMax - aabbMin;
+    }
+
+    // mesh data is only ever moved
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    void buildBvh()
+    {
+        if (!vertices.empty())
+            bvh.build(indices, &vertices[0].Position.x, sizeof(Vertex));
+    }
+
+    // frees the CPU side geometry once it lives in a GeometryBuffer, bounds, LOD table, meshlets and BVH stay
+    void releaseData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<VertexSkin>().swap(skins);
+        vector<unsigned int>().swap(indices);
+        vector<unsigned int>().swap(lodIndices);
+    }
+
+    // frustum test of the cluster sphere and backface test of its normal cone, eye is the camera in model space.
+    // The cone test only holds in model space while model keeps angles, see keepsAngles, pass cone = false if not.
+    bool isMeshletVisible(const Meshlet &meshlet, const glm::mat4 &model, const Frustum &frustum, glm::vec3 eye,
+                          bool cone = true) const
+    {
+        glm::vec3 toCenter = meshlet.center - eye;
+        if (cone && glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+            return false;
+        return frustum.intersectsSphere(glm::vec3(model * glm::vec4(meshlet.center, 1.0f)), meshlet.radius * maxScale(model));
+    }
+
+    // byte offset of a meshlet's first index in the element buffer
+    const void *meshletOffset(const Meshlet &meshlet) const
+    {
+        return (const void*)(size_t(firstIndex + meshlet.firstIndex) * sizeof(unsigned int));
+    }
+
+    // appends the mesh to geometry, packed positions are normalized to its own bounds
+    void upload(GeometryBuffer &geometry)
+    {
+        upload(geometry, aabbMin, aabbMax);
+    }
+
+    // appends the mesh to geometry, packed positions are normalized to [boundsMin, boundsMax]
+    // so meshes sharing the bounds can be drawn together
+    void upload(GeometryBuffer &geometry, glm::vec3 boundsMin, glm::vec3 boundsMax)
+    {
+        format = geometry.format;
+        packMin = boundsMin;
+        packExtent = boundsMax - boundsMin;
+        const VertexSkin *skinData = skins.empty() ? nullptr : skins.data();
+        if (format == VERTEX_PACKED) {
+            vector<PackedVertex> packed = packVertices(boundsMin, boundsMax);
+            baseVertex = geometry.appendVertices(packed.data(), packed.size(), materialLayer, skinData);
+        } else
+            baseVertex = geometry.appendVertices(vertices.data(), vertices.size(), materialLayer, skinData);
+        firstIndex = geometry.appendIndices(indices.data(), indices.size());
+        geometry.appendIndices(lodIndices.data(), lodIndices.size());
+        VAO = geometry.VAO;
+    }
+
+    // sphere test first, then the model space box transformed to a world space AABB
+    bool isVisible(const glm::mat4 &model, const Frustum &frustum) const
+    {
+        glm::vec3 center(model * glm::vec4(sphereCenter, 1.0f));
+        if (!frustum.intersectsSphere(center, sphereRadius * maxScale(model)))
+            return false;
+        glm::mat3 linear(model);
+        glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+        glm::vec3 boxCenter(model * glm::vec4((aabbMin + aabbMax) * 0.5f, 1.0f));
+        return frustum.intersectsBox(boxCenter, absLinear * ((aabbMax - aabbMin) * 0.5f));
+    }
+
+    // coarsest LOD whose simplification error projects to at most view.pixelError pixels
+    GLuint selectLod(const glm::mat4 &model, const ViewInfo &view) const
+    {
+        float scale = maxScale(model);
+        glm::vec3 center(model * glm::vec4(sphereCenter, 1.0f));
+        float radius = sphereRadius * scale;
+        float distance = glm::length(center - view.position) - radius;
+        if (distance <= 0.0f)
+            return 0;
+
+        float pixelsPerUnit = view.lodScale * scale / distance;
+        GLuint lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= view.pixelError)
+            lod++;
+        return lod;
+    }
+
+    // diameter of the bounding sphere on screen in pixels, FLT_MAX with the camera inside it
+    float screenSize(const glm::mat4 &model, const ViewInfo &view) const
+    {
+        float scale = maxScale(model);
+        glm::vec3 center(model * glm::vec4(sphereCenter, 1.0f));
+        float radius = sphereRadius * scale;
+        float distance = glm::length(center - view.position) - radius;
+        return distance > 0.0f ? 2.0f * radius * view.lodScale / distance : FLT_MAX;
+    }
+
+    // byte offset of lods[lod] in the element buffer
+    const void *indexOffset(GLuint lod) const
+    {
+        return (const void*)(size_t(firstIndex + lods[lod].firstIndex) * sizeof(unsigned int));
+    }
+
+    // meshes with the same textures can share one draw call
+    bool sameMaterial(const Mesh &other) const
+    {
+        if (textures.size() != other.textures.size()) return false;
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id) return false;
+        return true;
+    }
+
+    // draws lods[lod] for every instance, instanced attributes are up to the caller
+    void DrawInstanced(GLuint lod, GLsizei instanceCount)
+    {
+        GLState::bindVertexArray(VAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT, indexOffset(lod),
+                                          instanceCount, baseVertex);
+    }
+
+    // render the mesh
+    void Draw(Shader &shader, GLuint lod = 0)
+    {
+        bindTextures(shader);
+        setPackedBounds(shader);
+
+        // draw mesh
+        GLState::bindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, lods[lod].indexCount, GL_UNSIGNED_INT, indexOffset(lod), baseVertex);
+        // the VAO and textures stay bound, the next mesh sharing them binds nothing, see GLState
+    }
+
+    // binds the textures to the units the shader's samplers read from
+    void bindTextures(Shader &shader)
+    {
+        const BindingTable &table = bindingTable(shader);
+        for (GLuint i = table.first; i < table.first + table.count; i++) {
+            GLState::bindTextureUnit(textureBindings[i].unit, textureBindings[i].target, textureBindings[i].texture);
+        }
+    }
+
+    // packed positions are relative to the pack bounds
+    void setPackedBounds(Shader &shader) const
+    {
+        if (format != VERTEX_PACKED) return;
+        shader.setVec3("aabbMin"_u, packMin);
+        shader.setVec3("aabbExtent"_u, packExtent);
+    }
+
+    static float maxScale(const glm::mat4 &model)
+    {
+        return std::max(glm::length(glm::vec3(model[0])),
+                        std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    }
+
+    // true if model only rotates, mirrors, scales uniformly and translates. Non-uniform scale, or a rotated
+    // child of it, shears the angles between normals.
+    static bool keepsAngles(const glm::mat4 &model)
+    {
+        glm::mat3 linear(model);
+        glm::mat3 gram = glm::transpose(linear) * linear; // scale squared times identity for those
+        float scale = (gram[0][0] + gram[1][1] + gram[2][2]) / 3.0f;
+        for (int c = 0; c < 3; c++)
+            for (int r = 0; r < 3; r++)
+                if (std::abs(gram[c][r] - (c == r ? scale : 0.0f)) > 1e-4f * scale)
+                    return false;
+        return true;
+    }
+
+private:
+    // where the textures go for one shader program, resolved on the first draw with it
+    struct BindingTable {
+        GLuint shader; // Shader::serial
+        GLuint revision; // Shader::revision the units were looked up for
+        GLuint first, count; // range of textureBindings
+    };
+    struct TextureBinding {
+        GLuint unit;
+        GLuint texture;
+        GLenum target;
+    };
+    vector<BindingTable> bindingTables;
+    vector<TextureBinding> textureBindings;
+
+    /*  Functions    */
+    // The Nth texture of a type is sampled by texture_<type>N, plain or inside a material struct.
+    // Textures the shader does not sample are left out. Each shader has one table, replaced when it is rebuilt.
+    const BindingTable &bindingTable(Shader &shader)
+    {
+        auto found = std::find_if(bindingTables.begin(), bindingTables.end(),
+                                  [&](const BindingTable &table) { return table.shader == shader.serial; });
+        if (found != bindingTables.end()) {
+            if (found->revision == shader.revision)
+                return *found;
+            // drop the stale bindings, the new ones go to the end
+            textureBindings.erase(textureBindings.begin() + found->first,
+                                  textureBindings.begin() + found->first + found->count);
+            for (BindingTable &table : bindingTables)
+                if (table.first > found->first)
+                    table.first -= found->count;
+            bindingTables.erase(found);
+        }
+
+        BindingTable table = { shader.serial, shader.revision, GLuint(textureBindings.size()), 0 };
+        map<string, unsigned int> numbers;
+        for (const Texture &texture : textures) {
+            string name = texture.type + std::to_string(++numbers[texture.type]);
+            GLint unit = shader.samplerUnit(name);
+            if (unit < 0)
+                unit = shader.samplerUnit("material." + name);
+            if (unit < 0) continue;
+            textureBindings.push_back({ GLuint(unit), texture.id, texture.target });
+            table.count++;
+        }
+        bindingTables.push_back(table);
+        return bindingTables.back();
+    }
+
+    // AABB, and a Ritter bounding sphere which is usually tighter than the box's circumsphere
+    void calculateBounds()
+    {
+        aabbMin = aabbMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+        for (const Vertex &vertex : vertices) {
+            aabbMin = glm::min(aabbMin, vertex.Position);
+            aabbMax = glm::max(aabbMax, vertex.Position);
+        }
+
+        vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        MeshOptimizer::boundingSphere(positions.data(), positions.size(), sphereCenter, sphereRadius);
+        // the box circumsphere wins on some shapes
+        float boxRadius = glm::length(aabbMax - aabbMin) * 0.5f;
+        if (boxRadius < sphereRadius) {
+            sphereCenter = (aabbMin + aabbMax) * 0.5f;
+            sphereRadius = boxRadius;
+        }
+    }
+
+    // quantizes the vertices into PackedVertex
+    vector<PackedVertex> packVertices(glm::vec3 boundsMin, glm::vec3 boundsMax) const
+    {
+        glm::vec3 extent = boundsMax - boundsMin;
+        glm::vec3 invExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                            extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                            extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+        vector<PackedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const Vertex &vertex = vertices[i];
+            glm::vec3 position = glm::clamp((vertex.Position - boundsMin) * invExtent, 0.0f, 1.0f);
+            for (int c = 0; c < 3; c++)
+                packed[i].Position[c] = GLushort(std::round(position[c] * 65535.0f));
+            // handedness of the tangent frame, so the bitangent can be rebuilt from normal and tangent
+            bool rightHanded = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) >= 0.0f;
+            packed[i].Position[3] = rightHanded ? 65535 : 0;
+            packOctahedral(vertex.Normal, packed[i].Normal);
+            packOctahedral(vertex.Tangent, packed[i].Tangent);
+            packed[i].TexCoords[0] = packHalf(vertex.TexCoords.x);
+            packed[i].TexCoords[1] = packHalf(vertex.TexCoords.y);
+        }
+        return packed;
+    }
+};
+
+// Assimp file access through AssetFile, so models and the files they reference (.mtl, textures) are read from the
+// mounted asset pack, or memory mapped from disk if the pack doesn't hold them
+class PackIOStream : public Assimp::IOStream {
+public:
+    explicit PackIOStream(const string &path) : file(path), position(0) {}
+
+    bool isOpen() const { return file.isOpen(); }
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if (size == 0) return 0;
+        count = std::min(count, (file.length() - position) / size);
+        std::memcpy(buffer, file.data() + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void *, size_t, size_t) override { return 0; }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? position : file.length();
+        if (base + offset > file.length()) return aiReturn_FAILURE;
+        position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return file.length(); }
+    void Flush() override {}
+
+private:
+    AssetFile file;
+    size_t position;
+};
+
+class PackIOSystem : public Assimp::IOSystem {
+public:
+    bool Exists(const char *path) const override
+    {
+        return AssetPack::mounted().contains(path) || fallback.Exists(path);
+    }
+
+    char getOsSeparator() const override { return '/'; }
+
+    Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+    {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+            return fallback.Open(path, mode);
+        PackIOStream *stream = new PackIOStream(path);
+        if (stream->isOpen()) return stream;
+        delete stream;
+        return nullptr;
+    }
+
+    void Close(Assimp::IOStream *stream) override { delete stream; }
+
+private:
+    Assimp::DefaultIOSystem fallback;
+};
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+GLenum compressedFormat(BlockFormat format)
+{
+    switch (format) {
+    case BLOCK_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BLOCK_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_BC4: return GL_COMPRESSED_RED_RGTC1;
+    default: return GL_COMPRESSED_RG_RGTC2;
+    }
+}
+
+// uploads the levels of image as is, the driver does no decoding or mipmap generation.
+// Sampling starts at the first uploaded level, the coarser ones must already be there.
+void uploadCompressedTexture(GLuint textureID, const CompressedImage &image)
+{
+    GLState::bindTexture(GL_TEXTURE_2D, textureID);
+    for (size_t i = 0; i < image.levels.size(); i++) {
+        const CompressedLevel &level = image.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, image.firstLevel + i, compressedFormat(image.format), level.width, level.height,
+                               0, level.data.size(), level.data.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, image.firstLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levelCount - 1);
+}
+
+// reads the block compressed copy of an image, compressing the image into <image>.dds first unless that is
+// newer than the image. Only the levels no larger than maxSize texels on either side are kept, 0 keeps all.
+bool loadCompressedImage(const string &filename, CompressedImage &image, int maxSize = 0)
+{
+    string cachePath = filename + ".dds";
+    std::uint64_t sourceSize, cacheSize;
+    std::int64_t sourceTime, cacheTime;
+    if (assetStat(filename, sourceSize, sourceTime) && assetStat(cachePath, cacheSize, cacheTime) && cacheTime >= sourceTime) {
+        AssetFile cache(cachePath);
+        CompressedImage info;
+        if (cache.isOpen() && TextureCompressor::loadDds(cache.data(), cache.length(), info, INT_MAX)) {
+            int first = maxSize > 0 ? TextureCompressor::levelFor(info.width, info.height, maxSize) : 0;
+            if (TextureCompressor::loadDds(cache.data(), cache.length(), image, first) && !image.levels.empty())
+                return true;
+        }
+    }
+
+    int width, height, nrComponents;
+    unsigned char *data = loadImage(filename, &width, &height, &nrComponents);
+    if (!data) return false;
+    image = TextureCompressor::compress(data, width, height, nrComponents, TextureCompressor::formatFor(nrComponents));
+    stbi_image_free(data);
+    if (!TextureCompressor::saveDds(cachePath, image))
+        cout << "Texture cache failed to write at path: " << cachePath << endl;
+    int first = maxSize > 0 ? TextureCompressor::levelFor(width, height, maxSize) : 0;
+    image.levels.erase(image.levels.begin(), image.levels.begin() + first);
+    image.firstLevel = first;
+    return true;
+}
+
+// Loads textures with only their small mips resident and streams the finer ones in once the meshes using them
+// are large enough on screen to need them. Draw with a ViewInfo requests the level each visible mesh needs,
+// update() reads the missing levels from the .dds cache on background threads, uploads the finished ones and
+// evicts the finest levels of the least recently wanted textures while the streamed levels exceed the budget.
+// Until its finer levels arrive a texture samples from its GL_TEXTURE_BASE_LEVEL, which is how eviction clamps it too.
+class TextureStreamer {
+public:
+    constexpr static int RESIDENT_SIZE = 64;        // levels up to this size load with the texture and are never evicted
+    constexpr static size_t MAX_READS = 4;          // level reads in flight
+    constexpr static unsigned int KEEP_FRAMES = 60; // frames an unused level stays while under budget
+
+    explicit TextureStreamer(size_t budget = size_t(256) << 20) : budget(budget) {}
+
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+    // creates a texture with the levels of the image up to RESIDENT_SIZE, 0 if the image can't be read
+    GLuint load(const string &filename)
+    {
+        CompressedImage image;
+        if (!loadCompressedImage(filename, image, RESIDENT_SIZE))
+            return 0;
+
+        GLuint id;
+        glGenTextures(1, &id);
+        uploadCompressedTexture(id, image);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        StreamedTexture texture;
+        texture.id = id;
+        texture.cachePath = filename + ".dds";
+        texture.format = image.format;
+        texture.width = image.width;
+        texture.height = image.height;
+        texture.tailLevel = texture.residentLevel = texture.wantedLevel = image.firstLevel;
+        for (const CompressedLevel &level : image.levels)
+            tailBytes += level.data.size();
+        index[id] = textures.size();
+        textures.push_back(std::move(texture));
+        return id;
+    }
+
+    // asks for the texture to be sharp at pixels texels across on screen, ignored for textures it did not load.
+    // Assumes the texture spans the mesh once, which makes the level needed log2(texture size / pixels).
+    void request(GLuint id, float pixels)
+    {
+        auto found = index.find(id);
+        if (found == index.end()) return;
+        StreamedTexture &texture = textures[found->second];
+        float size = std::max(texture.width, texture.height);
+        int level = pixels >= size ? 0 : int(std::log2(size / std::max(pixels, 1.0f)));
+        texture.wantedLevel = std::min(texture.wantedLevel, level);
+        texture.lastUsed = frame;
+    }
+
+    // once per frame with the GL context current: uploads the finished reads, starts reads for the levels
+    // requested since the last update and evicts down to the budget
+    void update()
+    {
+        for (StreamedTexture &texture : textures)
+            if (texture.read.valid() && texture.read.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                finishRead(texture);
+        evict(0);
+
+        order.clear();
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].wantedLevel < textures[i].residentLevel && !textures[i].read.valid() && !textures[i].failed)
+                order.push_back(i);
+        // the textures missing the most levels first
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return textures[a].residentLevel - textures[a].wantedLevel > textures[b].residentLevel - textures[b].wantedLevel;
+        });
+        for (size_t i : order) {
+            if (reads >= MAX_READS) break;
+            StreamedTexture &texture = textures[i];
+            int first = texture.wantedLevel;
+            size_t bytes = 0;
+            for (int level = first; level < texture.residentLevel; level++)
+                bytes += levelBytes(texture, level);
+            while (first < texture.residentLevel && !evict(bytes)) // settle for coarser levels that fit
+                bytes -= levelBytes(texture, first++);
+            if (first < texture.residentLevel)
+                startRead(texture, first, bytes);
+        }
+
+        for (StreamedTexture &texture : textures)
+            texture.wantedLevel = texture.tailLevel;
+        frame++;
+    }
+
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t budgetBytes() const { return budget; }
+    // levels in GL or being read beyond the ones loaded with the textures, what the budget limits
+    size_t streamedBytes() const { return residentBytes + pendingBytes; }
+    // levels loaded with the textures
+    size_t tailBytesTotal() const { return tailBytes; }
+    size_t textureCount() const { return textures.size(); }
+    size_t pendingReads() const { return reads; }
+
+private:
+    struct StreamedTexture {
+        GLuint id = 0;
+        string cachePath;
+        BlockFormat format = BLOCK_BC1;
+        int width = 0, height = 0;
+        int tailLevel = 0;     // first level of the ones loaded with the texture
+        int residentLevel = 0; // finest level in GL, the base level
+        int wantedLevel = 0;   // finest level requested since the last update
+        unsigned int lastUsed = 0;
+        bool failed = false;   // the cache could not be read, stays at the loaded levels
+        size_t readBytes = 0;
+        std::future<CompressedImage> read;
+    };
+
+    vector<StreamedTexture> textures;
+    std::unordered_map<GLuint, size_t> index;
+    vector<size_t> order;
+    size_t budget;
+    size_t residentBytes = 0, pendingBytes = 0, tailBytes = 0;
+    size_t reads = 0;
+    unsigned int frame = 0;
+
+    static size_t levelBytes(const StreamedTexture &texture, int level)
+    {
+        return TextureCompressor::levelSize(TextureCompressor::levelWidth(texture.width, level),
+                                            TextureCompressor::levelWidth(texture.height, level), texture.format);
+    }
+
+    void startRead(StreamedTexture &texture, int firstLevel, size_t bytes)
+    {
+        string path = texture.cachePath;
+        int lastLevel = texture.residentLevel - 1;
+        texture.read = std::async(std::launch::async, [path, firstLevel, lastLevel]() {
+            AssetFile file(path);
+            CompressedImage image;
+            if (!file.isOpen() || !TextureCompressor::loadDds(file.data(), file.length(), image, firstLevel, lastLevel))
+                image.levels.clear();
+            return image;
+        });
+        texture.readBytes = bytes;
+        pendingBytes += bytes;
+        reads++;
+    }
+
+    void finishRead(StreamedTexture &texture)
+    {
+        CompressedImage image = texture.read.get();
+        pendingBytes -= texture.readBytes;
+        reads--;
+        if (image.levels.empty() || image.firstLevel + int(image.levels.size()) != texture.residentLevel) {
+            cout << "ERROR::TEXTURE:: failed to stream " << texture.cachePath << endl;
+            texture.failed = true;
+            return;
+        }
+        uploadCompressedTexture(texture.id, image);
+        texture.residentLevel = image.firstLevel;
+        residentBytes += texture.readBytes;
+    }
+
+    // drops the finest level of the least recently requested textures until bytes more fit in the budget, and
+    // levels not requested for KEEP_FRAMES even then. Levels requested this frame stay. Returns whether bytes fit.
+    bool evict(size_t bytes)
+    {
+        while (true) {
+            StreamedTexture *oldest = nullptr;
+            for (StreamedTexture &texture : textures)
+                if (texture.residentLevel < texture.tailLevel && texture.residentLevel < texture.wantedLevel
+                        && !texture.read.valid() && (!oldest || texture.lastUsed < oldest->lastUsed))
+                    oldest = &texture;
+            bool overBudget = residentBytes + pendingBytes + bytes > budget;
+            if (!oldest || (!overBudget && frame - oldest->lastUsed < KEEP_FRAMES))
+                return !overBudget;
+            // the level is below the base level now and never sampled, respecifying it empty frees its memory
+            int level = oldest->residentLevel++;
+            GLState::bindTexture(GL_TEXTURE_2D, oldest->id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, oldest->residentLevel);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat(oldest->format), 0, 0, 0, 0, nullptr);
+            residentBytes -= levelBytes(*oldest, level);
+        }
+    }
+};
+
+// where the time of Model loads goes, in milliseconds. A phase does not count the texture loads inside it.
+struct LoadTimings {
+    double fileRead = 0.0;    // mapping the model file and touching its pages, so parse is not waiting on the disk
+    double parse = 0.0;       // Assimp or ObjLoader reading the file
+    double postProcess = 0.0; // Assimp's triangulation and tangents
+    double convert = 0.0;     // processMesh and processGeometry: welding, optimizing, LODs and meshlets
+    double textures = 0.0;    // reading and decoding images or their .dds cache, and uploading them
+    double upload = 0.0;      // vertex and index buffers, waiting for the GL to finish
+    double cacheRead = 0.0;   // reading the .meshcache instead of parse, postProcess and convert
+    double cacheWrite = 0.0;  // writing the .meshcache
+    GLuint cacheHits = 0;
+};
+
+struct ModelOptions {
+    VertexFormat format = VERTEX_FULL;
+    shared_ptr<GeometryBuffer> geometry; // pack several models of the same format together, its format wins
+    bool keepMeshData = true;            // keep Mesh::vertices/indices after upload
+    bool buildBvh = false;               // build the per mesh BVHs Model::raycast needs
+    bool clusterCulling = false;         // cull meshlets every frame in Draw with a ViewInfo
+    bool objLoader = false;              // read .obj files with the parallel ObjLoader instead of Assimp
+    shared_ptr<TextureStreamer> textureStreamer; // stream the finer mips of the textures, may be shared by many models
+    bool textureArrays = false;          // pack the textures into GL_TEXTURE_2D_ARRAYs so meshes of different materials
+                                         // draw together, needs a sampler2DArray shader. Not with a textureStreamer.
+    LoadTimings *timings = nullptr;      // adds the time of each load phase to it
+};
+
+class Model
+{
+public:
+    /*  Model Data */
+    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Mesh> meshes;
+    string directory;
+    bool gammaCorrection;
+    VertexFormat vertexFormat;
+    shared_ptr<GeometryBuffer> geometry; // holds all meshes, may be shared with other models of the same format
+    TransformHierarchy transforms;       // node 0 places the model, the file's node transforms hang below it
+    vector<Bone> bones;                  // skeleton of the skinned meshes, VertexSkin::BoneIds index into it
+    vector<AnimationClip> clips;
+    int skinNode = 0;                    // node the skinned meshes are relative to
+    shared_ptr<TextureStreamer> textureStreamer; // loads the textures when set, Draw with a ViewInfo requests their mips
+
+    /*  Functions   */
+    // constructor, expects a filepath to a 3D model.
+    Model(string const &path, bool gamma = false, const ModelOptions &options = ModelOptions())
+        : gammaCorrection(gamma), vertexFormat(options.geometry ? options.geometry->format : options.format),
+          geometry(options.geometry), textureStreamer(options.textureStreamer), useObjLoader(options.objLoader),
+          timings(options.timings)
+    {
+        if (!geometry)
+            geometry = make_shared<GeometryBuffer>(vertexFormat);
+        transforms.addNode(-1);
+        loadModel(path);
+        startPhase();
+        if (options.textureArrays && !textureStreamer)
+            packTextureArrays();
+        endPhase(&LoadTimings::textures);
+        uploadMeshes();
+        if (timings)
+            glFinish();
+        endPhase(&LoadTimings::upload);
+        if (options.buildBvh)
+            for (Mesh &mesh : meshes)
+                mesh.buildBvh();
+        if (!options.keepMeshData)
+            for (Mesh &mesh : meshes)
+                mesh.releaseData();
+        clusterCulling = options.clusterCulling;
+    }
+
+    // draws the meshes where transforms places them, setting only the model uniform once per node. For shaders
+    // without normalMat, like outlines.
+    void Draw(Shader &shader)
+    {
+        transforms.update();
+        drawRuns(shader, transforms, nullptr, nullptr, nullptr);
+    }
+
+    // draws the meshes where transforms places them, setting the model and normalMat uniforms once per node.
+    // view must be rigid like a lookAt matrix, normalMat is then its rotation times the node's cached normal matrix.
+    void Draw(Shader &shader, const glm::mat4 &view)
+    {
+        glm::mat3 rotation(view);
+        transforms.update();
+        drawRuns(shader, transforms, &rotation, nullptr, nullptr);
+    }
+
+    // like Draw with a view matrix, but only the meshes inside the view frustum and at the LOD matching their
+    // size on screen. Adds the culled and drawn mesh counts to stats.
+    void Draw(Shader &shader, const ViewInfo &view, DrawStats *stats = nullptr)
+    {
+        transforms.update();
+        Draw(shader, view, transforms, stats);
+    }
+
+    // draws the meshes where nodes, an updated copy of transforms, places them. This is how a ModelInstance
+    // draws the shared model with its own transforms.
+    void Draw(Shader &shader, const glm::mat4 &view, const TransformHierarchy &nodes)
+    {
+        glm::mat3 rotation(view);
+        drawRuns(shader, nodes, &rotation, nullptr, nullptr);
+    }
+
+    void Draw(Shader &shader, const ViewInfo &view, const TransformHierarchy &nodes, DrawStats *stats = nullptr)
+    {
+        if (clusterCulling)
+            drawClusters(shader, nodes, view, stats);
+        else
+            drawRuns(shader, nodes, &view.rotation, &view, stats);
+    }
+
+    // draws one animated character in the pose of state, which Animator::update has brought up to date.
+    // Its palette must be bound to the shader's BonePalette block, see BonePaletteBuffer.
+    void Draw(Shader &shader, const glm::mat4 &view, const AnimationState &state)
+    {
+        glm::mat3 rotation(view);
+        drawRuns(shader, state.pose, &rotation, nullptr, nullptr);
+    }
+
+    // a character in the bind pose playing clip, placed by its pose's node 0
+    AnimationState createAnimationState(int clip = -1) const
+    {
+        AnimationState state;
+        state.pose = transforms;
+        state.clip = clip;
+        state.skinNode = skinNode;
+        state.pose.update();
+        Animator::computePalette(state.pose, bones, skinNode, state.palette);
+        return state;
+    }
+
+    // closest hit of a world space ray with the meshes where transforms places them.
+    // Only meshes with a BVH (ModelOptions::buildBvh) are tested. Returns true if hit was updated.
+    bool raycast(glm::vec3 origin, glm::vec3 direction, ModelHit &hit)
+    {
+        transforms.update();
+        return raycast(origin, direction, hit, transforms);
+    }
+
+    // the same with the meshes where nodes, an updated copy of transforms, places them
+    bool raycast(glm::vec3 origin, glm::vec3 direction, ModelHit &hit, const TransformHierarchy &nodes) const
+    {
+        bool found = false;
+        for (GLuint i = 0; i < meshes.size(); i++) {
+            // t is the same in mesh space as long as the direction is transformed without normalizing
+            const glm::mat4 &inverse = nodes.inverseWorld(meshes[i].node);
+            Ray ray(glm::vec3(inverse * glm::vec4(origin, 1.0f)), glm::vec3(inverse * glm::vec4(direction, 0.0f)), hit.t);
+            RayHit meshHit;
+            if (!meshes[i].bvh.intersect(ray, meshHit)) continue;
+            hit.t = meshHit.t;
+            hit.mesh = i;
+            hit.triangle = meshHit.triangle;
+            found = true;
+        }
+        if (found)
+            hit.position = origin + direction * hit.t;
+        return found;
+    }
+
+private:
+    bool useObjLoader;
+    LoadTimings *timings;
+    std::chrono::steady_clock::time_point phaseStart;
+    double phaseTextures = 0.0; // timings->textures when the phase started
+    bool keepAllNodes = false;
+
+    // consecutive meshes with the same material and node, submitted with one multi-draw
+    struct DrawRun {
+        GLuint firstMesh;
+        GLuint meshCount;
+        GLuint node;
+    };
+    vector<DrawRun> runs;
+    // per draw scratch for glMultiDrawElementsBaseVertex
+    vector<GLsizei> drawCounts;
+    vector<const void *> drawOffsets;
+    vector<GLint> drawBaseVertices;
+    bool clusterCulling = false; // see ModelOptions
+
+    // groups the meshes by material and node and appends them to the geometry buffer,
+    // quantized against the model bounds so one set of packing uniforms covers every mesh
+    void uploadMeshes()
+    {
+        std::stable_sort(meshes.begin(), meshes.end(), [](const Mesh &a, const Mesh &b) {
+            auto byId = [](const Texture &x, const Texture &y) { return x.id < y.id; };
+            if (std::lexicographical_compare(a.textures.begin(), a.textures.end(), b.textures.begin(), b.textures.end(), byId))
+                return true;
+            if (std::lexicographical_compare(b.textures.begin(), b.textures.end(), a.textures.begin(), a.textures.end(), byId))
+                return false;
+            return a.node < b.node;
+        });
+
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        for (size_t i = 0; i < meshes.size(); i++) {
+            boundsMin = i == 0 ? meshes[i].aabbMin : glm::min(boundsMin, meshes[i].aabbMin);
+            boundsMax = i == 0 ? meshes[i].aabbMax : glm::max(boundsMax, meshes[i].aabbMax);
+        }
+        runs.clear();
+        for (GLuint i = 0; i < meshes.size(); i++) {
+            meshes[i].upload(*geometry, boundsMin, boundsMax);
+            if (i > 0 && meshes[i].sameMaterial(meshes[i - 1]) && meshes[i].node == meshes[i - 1].node)
+                runs.back().meshCount++;
+            else
+                runs.push_back({ i, 1, meshes[i].node });
+        }
+    }
+
+    // Turns every material (the textures of a mesh) into a layer of texture arrays. Materials whose textures have
+    // the same types, sizes and formats share one array per texture, so their meshes sort into one run and draw
+    // with a single multi-draw, the shader picks the layer from the vertices. The 2D textures are deleted.
+    void packTextureArrays()
+    {
+        struct Material {
+            vector<Texture> textures;        // as loaded, empty for the meshes without textures
+            vector<CompressedImage> images;
+            string signature;                // types, sizes and formats, equal for materials sharing arrays
+            GLuint group = 0, layer = 0;
+        };
+        vector<Material> materials;
+        vector<GLuint> meshMaterial(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            auto same = [&](const Material &material) {
+                return material.textures.size() == meshes[i].textures.size()
+                    && std::equal(material.textures.begin(), material.textures.end(), meshes[i].textures.begin(),
+                                  [](const Texture &a, const Texture &b) { return a.id == b.id; });
+            };
+            auto found = std::find_if(materials.begin(), materials.end(), same);
+            meshMaterial[i] = found - materials.begin();
+            if (found == materials.end()) {
+                materials.emplace_back();
+                materials.back().textures = meshes[i].textures;
+            }
+        }
+
+        GLint maxLayers;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        map<string, GLuint> groups; // signature to its latest group, a new one starts when the arrays are full
+        vector<GLuint> groupLayers;
+        for (Material &material : materials) {
+            vector<Texture> kept;
+            for (const Texture &texture : material.textures) {
+                CompressedImage image;
+                if (!loadCompressedImage(directory + '/' + texture.path, image)) continue; // unsampled, as it was
+                material.signature += texture.type + ' ' + std::to_string(image.width) + 'x' + std::to_string(image.height)
+                                    + ' ' + std::to_string(image.format) + ';';
+                material.images.push_back(std::move(image));
+                kept.push_back(texture);
+            }
+            material.textures = std::move(kept);
+            auto group = groups.find(material.signature);
+            if (group == groups.end() || groupLayers[group->second] == GLuint(maxLayers)) {
+                groups[material.signature] = groupLayers.size();
+                group = groups.find(material.signature);
+                groupLayers.push_back(0);
+            }
+            material.group = group->second;
+            material.layer = groupLayers[material.group]++;
+        }
+
+        // one array per texture of each group, filled level by level from the compressed images
+        vector<vector<GLuint>> arrays(groupLayers.size());
+        for (const Material &material : materials) {
+            vector<GLuint> &textures = arrays[material.group];
+            for (size_t t = 0; t < material.images.size(); t++) {
+                const CompressedImage &image = material.images[t];
+                if (textures.size() <= t) {
+                    GLuint id;
+                    glGenTextures(1, &id);
+                    GLState::bindTexture(GL_TEXTURE_2D_ARRAY, id);
+                    for (int level = 0; level < image.levelCount; level++)
+                        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, compressedFormat(image.format),
+                                               image.levels[level].width, image.levels[level].height, groupLayers[material.group],
+                                               0, image.levels[level].data.size() * groupLayers[material.group], NULL);
+                    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, image.levelCount - 1);
+                    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                    textures.push_back(id);
+                }
+                GLState::bindTexture(GL_TEXTURE_2D_ARRAY, textures[t]);
+                for (int level = 0; level < image.levelCount; level++)
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, material.layer, image.levels[level].width,
+                                              image.levels[level].height, 1, compressedFormat(image.format),
+                                              image.levels[level].data.size(), image.levels[level].data.data());
+            }
+        }
+        GLState::bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Material &material = materials[meshMaterial[i]];
+            meshes[i].textures = material.textures;
+            for (size_t t = 0; t < material.textures.size(); t++) {
+                meshes[i].textures[t].id = arrays[material.group][t];
+                meshes[i].textures[t].target = GL_TEXTURE_2D_ARRAY;
+            }
+            meshes[i].materialLayer = material.layer;
+        }
+        for (const Texture &texture : textures_loaded)
+            GLState::deleteTextures(1, &texture.id);
+        textures_loaded.clear();
+    }
 
-        glBindVertexArray(0);
+    // sets the model and normalMat uniforms of a node, viewRotation is the rotation of a rigid view matrix.
+    // Without one only model is set.
+    static void setNodeUniforms(Shader &shader, const TransformHierarchy &nodes, GLuint node, const glm::mat3 *viewRotation)
+    {
+        shader.setMat4("model"_u, nodes.world(node));
+        if (viewRotation)
+            shader.setMat3("normalMat"_u, *viewRotation * nodes.normal(node));
     }
-};
 
-class Model
-{
-public:
-    /*  Model Data */
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
-    vector<Mesh> meshes;
-    string directory;
-    bool gammaCorrection;
+    // one VAO bind for the model and one multi-draw per run, culled and at the selected LODs if a view is given.
+    // Sets the uniforms of the (updated) nodes if viewRotation is given, otherwise draws with the shader's model matrix.
+    void drawRuns(Shader &shader, const TransformHierarchy &nodes, const glm::mat3 *viewRotation, const ViewInfo *view,
+                  DrawStats *stats)
+    {
+        if (meshes.empty()) return;
+        meshes[0].setPackedBounds(shader); // shared by every mesh of the model
+        GLState::bindVertexArray(geometry->VAO);
+        GLuint uniformNode = ~0u;
+        for (const DrawRun &run : runs) {
+            const glm::mat4 &model = nodes.world(run.node);
+            drawCounts.clear();
+            drawOffsets.clear();
+            drawBaseVertices.clear();
+            for (GLuint i = run.firstMesh; i < run.firstMesh + run.meshCount; i++) {
+                const Mesh &mesh = meshes[i];
+                if (view && !mesh.isVisible(model, view->frustum)) {
+                    if (stats) stats->culled++;
+                    continue;
+                }
+                GLuint lod = view ? mesh.selectLod(model, *view) : 0;
+                if (view && textureStreamer)
+                    requestTextures(mesh, model, *view);
+                drawCounts.push_back(mesh.lods[lod].indexCount);
+                drawOffsets.push_back(mesh.indexOffset(lod));
+                drawBaseVertices.push_back(mesh.baseVertex);
+            }
+            if (stats) stats->drawn += drawCounts.size();
+            if (drawCounts.empty()) continue;
+            if (stats) stats->drawCalls++;
+            if (run.node != uniformNode) {
+                setNodeUniforms(shader, nodes, run.node, viewRotation);
+                uniformNode = run.node;
+            }
+            meshes[run.firstMesh].bindTextures(shader);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                          drawCounts.size(), drawBaseVertices.data());
+        }
+    }
 
-    /*  Functions   */
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    void requestTextures(const Mesh &mesh, const glm::mat4 &model, const ViewInfo &view)
     {
-        loadModel(path);
+        float pixels = mesh.screenSize(model, view);
+        for (const Texture &texture : mesh.textures)
+            textureStreamer->request(texture.id, pixels);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    // like drawRuns with a view, but the full resolution LOD is culled per meshlet. The meshlets are ranges of
+    // the element buffer already, so the visible ones, merged where they are adjacent, go into the multi-draw.
+    void drawClusters(Shader &shader, const TransformHierarchy &nodes, const ViewInfo &view, DrawStats *stats)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        if (meshes.empty()) return;
+        meshes[0].setPackedBounds(shader);
+        GLState::bindVertexArray(geometry->VAO);
+        GLuint uniformNode = ~0u;
+        for (const DrawRun &run : runs) {
+            const glm::mat4 &model = nodes.world(run.node);
+            glm::vec3 eye(nodes.inverseWorld(run.node) * glm::vec4(view.position, 1.0f)); // cones are tested in mesh space
+            bool cones = Mesh::keepsAngles(model);
+            drawCounts.clear();
+            drawOffsets.clear();
+            drawBaseVertices.clear();
+            for (GLuint i = run.firstMesh; i < run.firstMesh + run.meshCount; i++) {
+                const Mesh &mesh = meshes[i];
+                if (!mesh.isVisible(model, view.frustum)) {
+                    if (stats) stats->culled++;
+                    continue;
+                }
+                GLuint lod = mesh.selectLod(model, view);
+                if (textureStreamer)
+                    requestTextures(mesh, model, view);
+                size_t before = drawCounts.size();
+                if (lod == 0 && !mesh.meshlets.empty()) {
+                    GLuint rangeEnd = ~0u; // index after the last range, extended while the meshlets are adjacent
+                    for (const Meshlet &meshlet : mesh.meshlets) {
+                        bool visible = mesh.isMeshletVisible(meshlet, model, view.frustum, eye, cones);
+                        if (stats) (visible ? stats->clustersDrawn : stats->clustersCulled)++;
+                        if (!visible) continue;
+                        if (meshlet.firstIndex == rangeEnd) {
+                            drawCounts.back() += meshlet.indexCount;
+                        } else {
+                            drawCounts.push_back(meshlet.indexCount);
+                            drawOffsets.push_back(mesh.meshletOffset(meshlet));
+                            drawBaseVertices.push_back(mesh.baseVertex);
+                        }
+                        rangeEnd = meshlet.firstIndex + meshlet.indexCount;
+                    }
+                } else {
+                    drawCounts.push_back(mesh.lods[lod].indexCount);
+                    drawOffsets.push_back(mesh.indexOffset(lod));
+                    drawBaseVertices.push_back(mesh.baseVertex);
+                }
+                if (drawCounts.size() == before) {
+                    if (stats) stats->culled++; // every cluster faces away or is outside
+                    continue;
+                }
+                if (stats) stats->drawn++;
+            }
+            if (drawCounts.empty()) continue;
+            if (stats) stats->drawCalls++;
+            if (run.node != uniformNode) {
+                setNodeUniforms(shader, nodes, run.node, &view.rotation);
+                uniformNode = run.node;
+            }
+            meshes[run.firstMesh].bindTextures(shader);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                          drawCounts.size(), drawBaseVertices.data());
+        }
     }
 
-private:
     /*  Functions   */
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+        // processed meshes are cached next to the model, skip the import if they are up to date
+        string cachePath = path + ".meshcache";
+        startPhase();
+        if (timings) {
+            AssetFile file(path);
+            volatile char touched = 0;
+            for (size_t offset = 0; offset < file.length(); offset += 4096)
+                touched += file.data()[offset];
+            endPhase(&LoadTimings::fileRead);
+        }
+        bool objLoader = useObjLoader && path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0;
+        if (loadMeshCache(path, cachePath, objLoader ? MESH_CACHE_OBJ : MESH_CACHE_ASSIMP)) {
+            if (timings) timings->cacheHits++;
+            endPhase(&LoadTimings::cacheRead);
+            return;
+        }
+        endPhase(&LoadTimings::cacheRead); // the failed lookup
+        if (objLoader) {
+            if (loadObj(path)) {
+                endPhase(&LoadTimings::convert);
+                saveMeshCache(path, cachePath, MESH_CACHE_OBJ);
+                endPhase(&LoadTimings::cacheWrite);
+                return;
+            }
+            cout << "ERROR::OBJ:: falling back to Assimp for " << path << endl;
+        }
+
+        // read file via ASSIMP, then post-process it as a separate step so the two can be timed apart
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        if (AssetPack::mounted().isOpen())
+            importer.SetIOHandler(new PackIOSystem()); // the importer owns and deletes it
+        const aiScene* scene = importer.ReadFile(path, 0);
+        endPhase(&LoadTimings::parse);
+        if (scene)
+            scene = importer.ApplyPostProcessing(aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        endPhase(&LoadTimings::postProcess);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
+        // animated nodes and bones are looked up by name, so skinned or animated files keep every node
+        keepAllNodes = scene->HasAnimations();
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+            keepAllNodes = keepAllNodes || scene->mMeshes[i]->HasBones();
+        skinNode = -1;
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, 0);
+        skinNode = std::max(skinNode, 0);
+        for (Bone &bone : bones)
+            bone.node = transforms.find(bone.name);
+        loadAnimations(scene);
+        endPhase(&LoadTimings::convert);
+        if (!keepAllNodes) // the cache has no skeletons or clips
+            saveMeshCache(path, cachePath, MESH_CACHE_ASSIMP);
+        endPhase(&LoadTimings::cacheWrite);
+    }
+
+    void startPhase()
+    {
+        if (!timings) return;
+        phaseStart = std::chrono::steady_clock::now();
+        phaseTextures = timings->textures;
+    }
+
+    // adds the time since the phase started to phase, less the texture loads in between, and starts the next phase
+    void endPhase(double LoadTimings::*phase)
+    {
+        if (!timings) return;
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - phaseStart).count();
+        timings->*phase += elapsed - (timings->textures - phaseTextures);
+        startPhase();
+    }
+
+    void loadAnimations(const aiScene *scene)
+    {
+        for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+            const aiAnimation *animation = scene->mAnimations[a];
+            double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+            AnimationClip clip;
+            clip.name = animation->mName.C_Str();
+            clip.duration = float(animation->mDuration / ticksPerSecond);
+            for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+                const aiNodeAnim *channel = animation->mChannels[c];
+                int node = transforms.find(channel->mNodeName.C_Str());
+                if (node < 0) continue;
+                clip.channels.push_back({ node, GLuint(clip.positionTimes.size()), channel->mNumPositionKeys,
+                                          GLuint(clip.rotationTimes.size()), channel->mNumRotationKeys,
+                                          GLuint(clip.scaleTimes.size()), channel->mNumScalingKeys });
+                for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+                    const aiVectorKey &key = channel->mPositionKeys[k];
+                    clip.positionTimes.push_back(float(key.mTime / ticksPerSecond));
+                    clip.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+                }
+                for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+                    const aiQuatKey &key = channel->mRotationKeys[k];
+                    clip.rotationTimes.push_back(float(key.mTime / ticksPerSecond));
+                    clip.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+                }
+                for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+                    const aiVectorKey &key = channel->mScalingKeys[k];
+                    clip.scaleTimes.push_back(float(key.mTime / ticksPerSecond));
+                    clip.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+                }
+            }
+            clips.push_back(std::move(clip));
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // Nodes with an identity transform are folded into their parent, so files that only use nodes for grouping
+    // (like OBJ) put every mesh on the model's node and keep batching across them.
+    void processNode(aiNode *node, const aiScene *scene, int parent)
     {
+        if (keepAllNodes || !node->mTransformation.IsIdentity()) // aiMatrix4x4 is row major
+            parent = transforms.addNode(parent, glm::transpose(glm::make_mat4(&node->mTransformation.a1)), node->mName.C_Str());
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
@@ -555,11 +2612,16 @@ private:
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(processMesh(mesh, scene));
+            meshes.back().node = parent;
+            if (mesh->HasBones()) { // the palette is relative to the first skinned mesh's node
+                if (skinNode < 0) skinNode = parent;
+                meshes.back().node = skinNode;
+            }
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, parent);
         }
 
     }
@@ -610,6 +2672,9 @@ private:
             vertex.Bitangent = vector;
             vertices.push_back(vertex);
         }
+        vector<VertexSkin> skins;
+        if (mesh->HasBones())
+            skins = processBones(mesh, vertices.size());
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -640,8 +2705,211 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
+        return processGeometry(mesh->mName.C_Str(), std::move(vertices), std::move(indices), std::move(textures),
+                               std::move(skins));
+    }
+
+    // the strongest Animator::MAX_INFLUENCES bone weights of every vertex, bones are shared by all meshes
+    vector<VertexSkin> processBones(const aiMesh *mesh, size_t vertexCount)
+    {
+        vector<vector<pair<GLuint, float>>> influences(vertexCount);
+        for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+            const aiBone *bone = mesh->mBones[b];
+            string name = bone->mName.C_Str();
+            GLuint id = 0;
+            while (id < bones.size() && bones[id].name != name)
+                id++;
+            if (id == bones.size()) {
+                if (bones.size() == Animator::MAX_BONES) {
+                    cout << "ERROR::MODEL:: more than " << Animator::MAX_BONES << " bones, " << name << " is not used" << endl;
+                    continue;
+                }
+                bones.push_back({ name, -1, glm::transpose(glm::make_mat4(&bone->mOffsetMatrix.a1)) });
+            }
+            for (unsigned int w = 0; w < bone->mNumWeights; w++)
+                if (bone->mWeights[w].mVertexId < vertexCount)
+                    influences[bone->mWeights[w].mVertexId].push_back({ id, bone->mWeights[w].mWeight });
+        }
+        vector<VertexSkin> skins(vertexCount);
+        vector<GLuint> ids;
+        vector<float> weights;
+        for (size_t v = 0; v < vertexCount; v++) {
+            ids.clear();
+            weights.clear();
+            for (const pair<GLuint, float> &influence : influences[v]) {
+                ids.push_back(influence.first);
+                weights.push_back(influence.second);
+            }
+            Animator::packWeights(ids.data(), weights.data(), ids.size(), skins[v].BoneIds, skins[v].BoneWeights);
+        }
+        return skins;
+    }
+
+    // the import steps shared by Assimp and ObjLoader meshes
+    Mesh processGeometry(const char *name, vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+                         vector<VertexSkin> skins = vector<VertexSkin>())
+    {
+        weldMesh(name, vertices, skins, indices);
+        optimizeMesh(name, vertices, skins, indices);
+        vector<unsigned int> lodIndices;
+        vector<MeshLod> lods;
+        buildLods(name, vertices, indices, lodIndices, lods);
+        vector<Meshlet> meshlets;
+        if (!vertices.empty())
+            meshlets = MeshOptimizer::buildMeshlets(indices, &vertices[0].Position.x, vertices.size(), sizeof(Vertex));
+
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(vertices), std::move(indices), std::move(textures), std::move(lodIndices), std::move(lods),
+                    std::move(meshlets), std::move(skins));
+    }
+
+    bool loadObj(string const &path)
+    {
+        ObjScene scene;
+        bool loaded = ObjLoader::load(path, scene);
+        endPhase(&LoadTimings::parse);
+        if (!scene.error.empty())
+            cout << "ERROR::OBJ:: " << scene.error << endl;
+        if (!loaded)
+            return false;
+
+        for (ObjMesh &objMesh : scene.meshes) {
+            vector<Vertex> vertices(objMesh.vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++) {
+                vertices[i].Position = objMesh.vertices[i].position;
+                vertices[i].Normal = objMesh.vertices[i].normal;
+                vertices[i].TexCoords = objMesh.vertices[i].texCoords;
+            }
+            vector<ObjVertex>().swap(objMesh.vertices);
+            calculateTangents(vertices, objMesh.indices);
+
+            // same texture order and sampler names as processMesh
+            vector<Texture> textures;
+            if (objMesh.material >= 0) {
+                const ObjMaterial &material = scene.materials[objMesh.material];
+                const pair<const string *, const char *> maps[] = {
+                    { &material.diffuseMap, "texture_diffuse" }, { &material.specularMap, "texture_specular" },
+                    { &material.normalMap, "texture_normal" }, { &material.heightMap, "texture_height" } };
+                for (const auto &map : maps)
+                    if (!map.first->empty())
+                        textures.push_back(findOrLoadTexture(*map.first, map.second));
+            }
+            meshes.push_back(processGeometry(objMesh.name.c_str(), std::move(vertices), std::move(objMesh.indices),
+                                             std::move(textures)));
+        }
+        return true;
+    }
+
+    // per vertex tangent frame from the texture coordinates, like aiProcess_CalcTangentSpace
+    static void calculateTangents(vector<Vertex> &vertices, const vector<unsigned int> &indices)
+    {
+        vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f)), bitangents(vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+            glm::vec3 edge1 = b.Position - a.Position, edge2 = c.Position - a.Position;
+            glm::vec2 uv1 = b.TexCoords - a.TexCoords, uv2 = c.TexCoords - a.TexCoords;
+            float det = uv1.x * uv2.y - uv2.x * uv1.y;
+            if (std::abs(det) < 1e-12f) continue;
+            float inverse = 1.0f / det;
+            glm::vec3 tangent = (edge1 * uv2.y - edge2 * uv1.y) * inverse;
+            glm::vec3 bitangent = (edge2 * uv1.x - edge1 * uv2.x) * inverse;
+            for (int k = 0; k < 3; k++) {
+                tangents[indices[i + k]] += tangent;
+                bitangents[indices[i + k]] += bitangent;
+            }
+        }
+        for (size_t v = 0; v < vertices.size(); v++) {
+            glm::vec3 normal = vertices[v].Normal;
+            glm::vec3 tangent = tangents[v] - normal * glm::dot(normal, tangents[v]); // Gram-Schmidt
+            float length = glm::length(tangent);
+            if (length < 1e-12f) { // no usable texture coordinates, any perpendicular will do
+                tangent = glm::cross(normal, std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+                length = glm::length(tangent);
+            }
+            tangent = length > 0.0f ? tangent / length : glm::vec3(1.0f, 0.0f, 0.0f);
+            float handedness = glm::dot(glm::cross(normal, tangent), bitangents[v]) < 0.0f ? -1.0f : 1.0f;
+            vertices[v].Tangent = tangent;
+            vertices[v].Bitangent = glm::cross(normal, tangent) * handedness;
+        }
+    }
+
+    constexpr static float WELD_EPSILON = 1e-6f;
+
+    // merges the per face corner vertices we get without aiProcess_JoinIdenticalVertices.
+    // Skinned vertices only merge with the same bones and weights.
+    void weldMesh(const char *name, vector<Vertex> &vertices, vector<VertexSkin> &skins, vector<unsigned int> &indices)
+    {
+        size_t before = vertices.size();
+        if (skins.empty()) {
+            MeshOptimizer::weldVertices(vertices, indices, WELD_EPSILON);
+        } else {
+            struct SkinnedVertex {
+                Vertex vertex;
+                VertexSkin skin; // compared bit for bit
+            };
+            vector<SkinnedVertex> skinned(vertices.size());
+            for (size_t v = 0; v < vertices.size(); v++)
+                skinned[v] = { vertices[v], skins[v] };
+            MeshOptimizer::weldVertices(skinned, indices, WELD_EPSILON, sizeof(Vertex) / sizeof(float));
+            vertices.resize(skinned.size());
+            skins.resize(skinned.size());
+            for (size_t v = 0; v < skinned.size(); v++) {
+                vertices[v] = skinned[v].vertex;
+                skins[v] = skinned[v].skin;
+            }
+        }
+        cout << "Mesh " << name << ": " << before << " -> " << vertices.size() << " vertices" << endl;
+    }
+
+    // reorders triangles for the post-transform cache and overdraw, then vertices for fetch locality
+    void optimizeMesh(const char *name, vector<Vertex> &vertices, vector<VertexSkin> &skins, vector<unsigned int> &indices)
+    {
+        if (indices.empty()) return;
+        VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+
+        vector<unsigned int> clusters;
+        MeshOptimizer::optimizeVertexCache(indices, vertices.size(), &clusters);
+        MeshOptimizer::optimizeOverdraw(indices, clusters, &vertices[0].Position.x, vertices.size(), sizeof(Vertex));
+        size_t uniqueCount;
+        vector<unsigned int> remap = MeshOptimizer::optimizeVertexFetch(indices, vertices.size(), &uniqueCount);
+        MeshOptimizer::remapVertices(vertices, remap, uniqueCount);
+        if (!skins.empty())
+            MeshOptimizer::remapVertices(skins, remap, uniqueCount);
+
+        VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+        cout << "Mesh " << name << ": ACMR " << before.acmr << " -> " << after.acmr
+             << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+    }
+
+    constexpr static GLuint MAX_LOD_LEVELS = 3;
+    constexpr static float LOD_MIN_REDUCTION = 0.9f;
+
+    // LOD chain at 50/25/12.5% of the triangles, each level simplified from the previous one.
+    // Stops early once the simplifier gets stuck on seams and borders.
+    void buildLods(const char *name, const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                   vector<unsigned int> &lodIndices, vector<MeshLod> &lods)
+    {
+        if (indices.empty()) return;
+        vector<unsigned int> current = indices;
+        float error = 0.0f;
+        for (GLuint level = 1; level <= MAX_LOD_LEVELS; level++) {
+            size_t target = indices.size() / 3 / (1 << level) * 3;
+            float levelError;
+            vector<unsigned int> simplified = MeshSimplifier::simplify(current, &vertices[0].Position.x, vertices.size(),
+                                                                       sizeof(Vertex), target, &levelError);
+            if (simplified.empty() || simplified.size() > current.size() * LOD_MIN_REDUCTION)
+                break;
+            MeshOptimizer::optimizeVertexCache(simplified, vertices.size());
+            error += levelError; // errors of consecutive levels add up
+            lods.push_back({ GLuint(lodIndices.size()), GLuint(simplified.size()), error });
+            lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+            current.swap(simplified);
+        }
+
+        cout << "Mesh " << name << ": LOD triangles " << indices.size() / 3;
+        for (const MeshLod &lod : lods)
+            cout << " / " << lod.indexCount / 3;
+        cout << endl;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -665,21 +2933,326 @@ private:
                 }
             }
             if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                unsigned int textureFromFile(const char *path, const string &directory);
-                texture.id = textureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+                textures.push_back(loadNewTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    Texture findOrLoadTexture(const string &path, const string &typeName)
+    {
+        auto loaded = std::find_if(textures_loaded.begin(), textures_loaded.end(),
+                                   [&](const Texture &texture) { return texture.path == path; });
+        return loaded != textures_loaded.end() ? *loaded : loadNewTexture(path.c_str(), typeName);
+    }
+
+    Texture loadNewTexture(const char *path, const string &typeName)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Texture texture;
+        unsigned int textureFromFile(const char *path, const string &directory);
+        if (textureStreamer) {
+            texture.id = textureStreamer->load(this->directory + '/' + path);
+            if (!texture.id)
+                cout << "Texture failed to load at path: " << path << endl;
+        } else {
+            texture.id = textureFromFile(path, this->directory);
+        }
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        if (timings)
+            timings->textures += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return texture;
+    }
+
+    /*  Mesh cache  */
+    // layout: header, then per mesh the vertex/index/texture/LOD index/LOD/meshlet counts, its node, the raw vertices,
+    // indices, LOD indices, LOD table and meshlets and the (type, path) pair of every texture. After the meshes the
+    // node count and per node below the root its parent, position, rotation, scale and name.
+    // Bump MESH_CACHE_VERSION whenever the processing changes.
+    constexpr static GLuint MESH_CACHE_MAGIC = 0x4853454d; // "MESH"
+    constexpr static GLuint MESH_CACHE_VERSION = 8;
+    // the loader that wrote a cache, ObjLoader and Assimp group meshes and compute tangents differently
+    constexpr static GLuint MESH_CACHE_ASSIMP = 0;
+    constexpr static GLuint MESH_CACHE_OBJ = 1;
+
+    struct MeshCacheHeader {
+        GLuint magic;
+        GLuint version;
+        GLuint loader;
+        long long sourceSize;
+        long long sourceTime;
+        GLuint meshCount;
+    };
+
+    template<typename T>
+    static void writeCache(ofstream &file, const T *data, size_t count) {
+        file.write(reinterpret_cast<const char *>(data), count * sizeof(T));
+    }
+
+    template<typename T>
+    static bool readCache(istream &file, T *data, size_t count) {
+        file.read(reinterpret_cast<char *>(data), count * sizeof(T));
+        return bool(file);
+    }
+
+    static void writeCacheString(ofstream &file, const string &str) {
+        GLuint length = str.size();
+        writeCache(file, &length, 1);
+        writeCache(file, str.data(), length);
+    }
+
+    static bool readCacheString(istream &file, string &str) {
+        GLuint length;
+        if (!readCache(file, &length, 1)) return false;
+        str.resize(length);
+        return length == 0 || readCache(file, &str[0], length);
+    }
+
+    static bool sourceStamp(string const &path, MeshCacheHeader &header) {
+        std::uint64_t size;
+        std::int64_t time;
+        if (!assetStat(path, size, time)) return false;
+        header.sourceSize = size;
+        header.sourceTime = time;
+        return true;
+    }
+
+    bool loadMeshCache(string const &path, string const &cachePath, GLuint loader)
+    {
+        AssetFile cache(cachePath);
+        if (!cache.isOpen()) return false;
+        MemoryStreamBuffer buffer(cache.data(), cache.length());
+        istream file(&buffer);
+        MeshCacheHeader expected, header;
+        if (!sourceStamp(path, expected) || !readCache(file, &header, 1))
+            return false;
+        if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.loader != loader
+                || header.sourceSize != expected.sourceSize || header.sourceTime != expected.sourceTime)
+            return false;
+
+        vector<Mesh> cached;
+        for (GLuint m = 0; m < header.meshCount; m++) {
+            GLuint counts[6], node;
+            if (!readCache(file, counts, 6) || !readCache(file, &node, 1)) return false;
+            vector<Vertex> vertices(counts[0]);
+            vector<unsigned int> indices(counts[1]), lodIndices(counts[3]);
+            vector<MeshLod> lods(counts[4]);
+            vector<Meshlet> meshlets(counts[5]);
+            vector<Texture> textures;
+            if (!readCache(file, vertices.data(), vertices.size()) || !readCache(file, indices.data(), indices.size())
+                    || !readCache(file, lodIndices.data(), lodIndices.size()) || !readCache(file, lods.data(), lods.size())
+                    || !readCache(file, meshlets.data(), meshlets.size()))
+                return false;
+            for (GLuint t = 0; t < counts[2]; t++) {
+                string type, texturePath;
+                if (!readCacheString(file, type) || !readCacheString(file, texturePath))
+                    return false;
+                textures.push_back(findOrLoadTexture(texturePath, type));
+            }
+            cached.push_back(Mesh(std::move(vertices), std::move(indices), std::move(textures), std::move(lodIndices),
+                                  std::move(lods), std::move(meshlets)));
+            cached.back().node = node;
+        }
+
+        GLuint nodeCount;
+        if (!readCache(file, &nodeCount, 1)) return false;
+        vector<int> parents(nodeCount);
+        vector<glm::vec3> positions(nodeCount), scales(nodeCount);
+        vector<glm::quat> rotations(nodeCount);
+        vector<string> names(nodeCount);
+        for (GLuint n = 0; n < nodeCount; n++)
+            if (!readCache(file, &parents[n], 1) || !readCache(file, &positions[n], 1) || !readCache(file, &rotations[n], 1)
+                    || !readCache(file, &scales[n], 1) || !readCacheString(file, names[n]))
+                return false;
+        for (GLuint n = 0; n < nodeCount; n++)
+            transforms.addNode(parents[n], positions[n], rotations[n], scales[n], names[n]);
+        meshes.insert(meshes.end(), make_move_iterator(cached.begin()), make_move_iterator(cached.end()));
+        return true;
+    }
+
+    void saveMeshCache(string const &path, string const &cachePath, GLuint loader)
+    {
+        MeshCacheHeader header = { MESH_CACHE_MAGIC, MESH_CACHE_VERSION, loader, 0, 0, GLuint(meshes.size()) };
+        if (!sourceStamp(path, header)) return;
+        ofstream file(cachePath, ios::binary | ios::trunc);
+        if (!file) {
+            cout << "Failed to write mesh cache: " << cachePath << endl;
+            return;
+        }
+        writeCache(file, &header, 1);
+        for (const Mesh &mesh : meshes) {
+            // lods[0] is implied by the indices, the rest are stored relative to lodIndices
+            vector<MeshLod> lods(mesh.lods.begin() + 1, mesh.lods.end());
+            for (MeshLod &lod : lods)
+                lod.firstIndex -= mesh.indices.size();
+            GLuint counts[6] = { GLuint(mesh.vertices.size()), GLuint(mesh.indices.size()), GLuint(mesh.textures.size()),
+                                 GLuint(mesh.lodIndices.size()), GLuint(lods.size()), GLuint(mesh.meshlets.size()) };
+            writeCache(file, counts, 6);
+            writeCache(file, &mesh.node, 1);
+            writeCache(file, mesh.vertices.data(), mesh.vertices.size());
+            writeCache(file, mesh.indices.data(), mesh.indices.size());
+            writeCache(file, mesh.lodIndices.data(), mesh.lodIndices.size());
+            writeCache(file, lods.data(), lods.size());
+            writeCache(file, mesh.meshlets.data(), mesh.meshlets.size());
+            for (const Texture &texture : mesh.textures) {
+                writeCacheString(file, texture.type);
+                writeCacheString(file, texture.path);
+            }
+        }
+        GLuint nodeCount = transforms.size() - 1;
+        writeCache(file, &nodeCount, 1);
+        for (int n = 1; n <= int(nodeCount); n++) {
+            int parent = transforms.parent(n);
+            glm::vec3 position = transforms.position(n), scale = transforms.scale(n);
+            glm::quat rotation = transforms.rotation(n);
+            writeCache(file, &parent, 1);
+            writeCache(file, &position, 1);
+            writeCache(file, &rotation, 1);
+            writeCache(file, &scale, 1);
+            writeCacheString(file, transforms.name(n));
+        }
+    }
+};
+
+// One placement of a shared Model. Holds only its own copy of the model's transforms, node 0 places it,
+// the geometry, textures and skeleton stay with the model.
+class ModelInstance {
+public:
+    shared_ptr<Model> model;
+    TransformHierarchy transforms;
+
+    explicit ModelInstance(const shared_ptr<Model> &model) : model(model), transforms(model->transforms) {}
+
+    void Draw(Shader &shader, const glm::mat4 &view)
+    {
+        transforms.update();
+        model->Draw(shader, view, transforms);
+    }
+
+    void Draw(Shader &shader, const ViewInfo &view, DrawStats *stats = nullptr)
+    {
+        transforms.update();
+        model->Draw(shader, view, transforms, stats);
+    }
+
+    bool raycast(glm::vec3 origin, glm::vec3 direction, ModelHit &hit)
+    {
+        transforms.update();
+        return model->raycast(origin, direction, hit, transforms);
+    }
+};
+
+// Loads every model once per process. Loads of the same file with the same options return the same Model, which
+// lives as long as someone holds it, so memory and load time grow with the distinct assets, not with their uses.
+// Place the uses with ModelInstances, the shared model's own transforms are the ones new instances start from.
+class ModelRegistry {
+public:
+    static shared_ptr<Model> load(const string &path, bool gamma = false, const ModelOptions &options = ModelOptions())
+    {
+        string key = AssetPack::normalize(path) + '\n' + optionsKey(gamma, options);
+        auto &models = entries();
+        auto found = models.find(key);
+        if (found != models.end())
+            if (shared_ptr<Model> model = found->second.lock())
+                return model;
+        shared_ptr<Model> model = make_shared<Model>(path, gamma, options);
+        models[key] = model;
+        return model;
+    }
+
+    static ModelInstance instance(const string &path, bool gamma = false, const ModelOptions &options = ModelOptions())
+    {
+        return ModelInstance(load(path, gamma, options));
+    }
+
+    // models currently alive, forgetting the ones nobody holds anymore
+    static size_t size()
+    {
+        auto &models = entries();
+        for (auto it = models.begin(); it != models.end();)
+            it = it->second.expired() ? models.erase(it) : std::next(it);
+        return models.size();
+    }
+
+private:
+    static map<string, weak_ptr<Model>> &entries()
+    {
+        static map<string, weak_ptr<Model>> models;
+        return models;
+    }
+
+    // options that change what is loaded or how it is stored. Shared geometry buffers and texture streamers
+    // count by identity.
+    static string optionsKey(bool gamma, const ModelOptions &options)
+    {
+        std::ostringstream key;
+        key << gamma << int(options.format) << options.keepMeshData << options.buildBvh << options.clusterCulling
+            << options.objLoader << options.textureArrays << ' ' << options.geometry.get() << ' ' << options.textureStreamer.get();
+        return key.str();
+    }
+};
+
+// skinning palettes of many AnimationStates in one uniform buffer, uploaded once per frame. Each palette starts at
+// an aligned offset and is bound to the BonePalette block with glBindBufferRange before its character is drawn.
+// The bound window always spans MAX_BONES matrices as the block declares, so it may reach into the next palettes.
+class BonePaletteBuffer {
+public:
+    constexpr static GLuint BINDING = 1; // uniform buffer binding point of the BonePalette block
+    constexpr static GLsizeiptr WINDOW_SIZE = Animator::MAX_BONES * sizeof(glm::mat4);
+
+    BonePaletteBuffer() : buffer(GLBuffer::create()), stride(0), paletteCount(0)
+    {
+        GLint alignment;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        this->alignment = std::max<GLsizeiptr>(alignment, sizeof(glm::mat4));
+    }
+
+    // points the BonePalette block of shader at BINDING
+    static void bindBlock(const Shader &shader)
+    {
+        GLuint block = glGetUniformBlockIndex(shader.ID, "BonePalette");
+        if (block != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.ID, block, BINDING);
+    }
+
+    // replaces the buffer contents with the palettes of states, in order
+    void upload(const vector<AnimationState> &states)
+    {
+        size_t bones = 0;
+        for (const AnimationState &state : states)
+            bones = std::max(bones, state.palette.size());
+        stride = (bones * sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+        paletteCount = states.size();
+        if (states.empty()) return;
+
+        GLsizeiptr size = (states.size() - 1) * stride + WINDOW_SIZE;
+        staging.assign(size / sizeof(glm::mat4), glm::mat4(1.0f));
+        for (size_t i = 0; i < states.size(); i++)
+            std::copy(states[i].palette.begin(), states[i].palette.end(), staging.begin() + i * stride / sizeof(glm::mat4));
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW); // orphan
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, staging.data());
+        GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // binds the palette of the state at index in the last upload
+    void bind(size_t index) const
+    {
+        if (index < paletteCount)
+            GLState::bindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, index * stride, WINDOW_SIZE);
+    }
+
+private:
+    GLBuffer buffer;
+    GLsizeiptr alignment, stride;
+    size_t paletteCount;
+    vector<glm::mat4> staging;
 };
 
 
+// Textures are block compressed on first load and the result is cached as <image>.dds next to the image,
+// later loads read the cache instead of decoding the image while it is newer than the image.
 unsigned int textureFromFile(const char *path, const string &directory)
 {
     string filename = string(path);
@@ -688,47 +3261,326 @@ unsigned int textureFromFile(const char *path, const string &directory)
     GLuint textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    CompressedImage image;
+    if (!loadCompressedImage(filename, image))
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return textureID;
+    }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    uploadCompressedTexture(textureID, image);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+
+// A glTF 2.0 scene (.glb, or .gltf with .bin buffers) drawn straight from the file's buffers. Every buffer view a
+// primitive reads becomes one GL buffer, uploaded from the memory mapped file in a single glBufferData, and the
+// vertex attribute pointers and index offsets come from the accessors, so no vertex is converted on the CPU.
+// Attributes go to the locations the model shaders use: POSITION 0, NORMAL 1, TEXCOORD_0 2, TANGENT 3,
+// JOINTS_0 5 and WEIGHTS_0 6. Base color textures are sampled as texture_diffuse1, normal textures as texture_normal1.
+class GltfModel
+{
+public:
+    struct Primitive {
+        GLVertexArray VAO;
+        GLenum mode;        // glTF modes are GL_POINTS..GL_TRIANGLE_FAN
+        GLsizei count;      // indices, or vertices without indices
+        GLenum indexType;   // 0 draws without indices
+        size_t indexOffset; // in bytes into the index buffer
+        int material;       // -1 for none
+    };
+
+    // a mesh placed by a node
+    struct Instance {
+        int node;
+        int mesh;
+    };
+
+    vector<vector<Primitive>> meshes;
+    vector<vector<Texture>> materials;
+    vector<Instance> instances;
+    TransformHierarchy transforms; // node 0 places the model, the file's nodes hang below it
+    string directory;
+    size_t uploadedBytes = 0;      // vertex and index data sent to GL
 
-        stbi_image_free(data);
+    explicit GltfModel(const string &path) : directory(path.substr(0, path.find_last_of('/')))
+    {
+        transforms.addNode(-1);
+        GltfDocument document;
+        string error;
+        if (!document.load(path, error)) {
+            cout << "ERROR::GLTF:: " << path << ": " << error << endl;
+            return;
+        }
+        loadMeshes(document);
+        loadMaterials(document);
+        loadNodes(document);
+        loaded = true;
     }
-    else
+
+    GltfModel(const GltfModel &) = delete;
+    GltfModel &operator=(const GltfModel &) = delete;
+
+    ~GltfModel()
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        for (GLuint texture : imageTextures)
+            if (texture) GLState::deleteTextures(1, &texture);
     }
 
-    return textureID;
-}
+    bool isLoaded() const { return loaded; }
+
+    // draws the meshes where transforms places them, setting the model and normalMat uniforms once per instance.
+    // view must be rigid like a lookAt matrix.
+    void Draw(Shader &shader, const glm::mat4 &view)
+    {
+        glm::mat3 rotation(view);
+        transforms.update();
+        const vector<vector<GLint>> &units = samplerUnits(shader);
+        for (const Instance &instance : instances) {
+            shader.setMat4("model"_u, transforms.world(instance.node));
+            shader.setMat3("normalMat"_u, rotation * transforms.normal(instance.node));
+            for (const Primitive &primitive : meshes[instance.mesh]) {
+                if (primitive.material >= 0) {
+                    const vector<Texture> &textures = materials[primitive.material];
+                    for (size_t t = 0; t < textures.size(); t++) {
+                        if (units[primitive.material][t] < 0) continue;
+                        GLState::bindTextureUnit(units[primitive.material][t], GL_TEXTURE_2D, textures[t].id);
+                    }
+                }
+                GLState::bindVertexArray(primitive.VAO);
+                if (primitive.indexType)
+                    glDrawElements(primitive.mode, primitive.count, primitive.indexType, (void*)primitive.indexOffset);
+                else
+                    glDrawArrays(primitive.mode, 0, primitive.count);
+            }
+        }
+    }
+
+    // vertex attribute location of a glTF attribute semantic, -1 for the ones the shaders don't read
+    static GLint attributeLocation(const string &semantic)
+    {
+        if (semantic == "POSITION") return 0;
+        if (semantic == "NORMAL") return 1;
+        if (semantic == "TEXCOORD_0") return 2;
+        if (semantic == "TANGENT") return 3;
+        if (semantic == "JOINTS_0") return 5;
+        if (semantic == "WEIGHTS_0") return 6;
+        return -1;
+    }
+
+private:
+    bool loaded = false;
+    vector<GLBuffer> viewBuffers; // per buffer view, uploaded when a primitive first reads it
+    vector<GLuint> imageTextures; // per image, loaded when a material first samples it
+    GLuint unitsShader = 0;       // Shader::serial the units were looked up for
+    GLuint unitsRevision = 0;     // and its Shader::revision
+    vector<vector<GLint>> units;  // texture unit of every material texture, -1 if the shader doesn't sample it
+
+    GLuint viewBuffer(const GltfDocument &document, int view)
+    {
+        if (!viewBuffers[view]) {
+            viewBuffers[view] = GLBuffer::create();
+            GLState::bindBuffer(GL_ARRAY_BUFFER, viewBuffers[view]);
+            glBufferData(GL_ARRAY_BUFFER, document.bufferViews[view].byteLength, document.viewData(view), GL_STATIC_DRAW);
+            uploadedBytes += document.bufferViews[view].byteLength;
+        }
+        return viewBuffers[view];
+    }
+
+    void loadMeshes(const GltfDocument &document)
+    {
+        viewBuffers.resize(document.bufferViews.size());
+        const JsonValue &meshList = document.json["meshes"];
+        meshes.resize(meshList.size());
+        for (size_t m = 0; m < meshList.size(); m++) {
+            const JsonValue &primitiveList = meshList[m]["primitives"];
+            for (size_t p = 0; p < primitiveList.size(); p++) {
+                const JsonValue &info = primitiveList[p];
+                int positions = info["attributes"]["POSITION"].asInt(-1);
+                if (positions < 0 || positions >= int(document.accessors.size())) {
+                    cout << "ERROR::GLTF:: mesh " << m << " primitive " << p << " has no positions" << endl;
+                    continue;
+                }
+                Primitive primitive;
+                primitive.VAO = GLVertexArray::create();
+                primitive.mode = GLenum(info["mode"].asInt(GL_TRIANGLES));
+                primitive.material = info["material"].asInt(-1);
+                if (primitive.material >= int(document.json["materials"].size())) {
+                    cout << "ERROR::GLTF:: mesh " << m << " primitive " << p << " has no material " << primitive.material << endl;
+                    primitive.material = -1;
+                }
+                primitive.count = GLsizei(document.accessors[positions].count);
+                primitive.indexType = 0;
+                primitive.indexOffset = 0;
+                GLState::bindVertexArray(primitive.VAO);
+
+                for (const auto &attribute : info["attributes"].objectMembers()) {
+                    GLint location = attributeLocation(attribute.first);
+                    int index = attribute.second.asInt(-1);
+                    if (location < 0 || index < 0 || index >= int(document.accessors.size())) continue;
+                    const GltfAccessor &accessor = document.accessors[index];
+                    if (accessor.bufferView < 0 || accessor.components > 4) continue;
+                    GLState::bindBuffer(GL_ARRAY_BUFFER, viewBuffer(document, accessor.bufferView));
+                    glEnableVertexAttribArray(location);
+                    const void *offset = (void*)accessor.byteOffset;
+                    GLsizei stride = GLsizei(document.bufferViews[accessor.bufferView].byteStride);
+                    if (attribute.first == "JOINTS_0")
+                        glVertexAttribIPointer(location, accessor.components, accessor.componentType, stride, offset);
+                    else
+                        glVertexAttribPointer(location, accessor.components, accessor.componentType,
+                                              accessor.normalized ? GL_TRUE : GL_FALSE, stride, offset);
+                }
+
+                int indices = info["indices"].asInt(-1);
+                if (indices >= 0 && indices < int(document.accessors.size())
+                        && document.accessors[indices].bufferView >= 0) {
+                    const GltfAccessor &accessor = document.accessors[indices];
+                    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, viewBuffer(document, accessor.bufferView));
+                    primitive.count = GLsizei(accessor.count);
+                    primitive.indexType = accessor.componentType;
+                    primitive.indexOffset = accessor.byteOffset;
+                }
+                GLState::bindVertexArray(0);
+                meshes[m].push_back(std::move(primitive));
+            }
+        }
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void loadMaterials(const GltfDocument &document)
+    {
+        imageTextures.resize(document.json["images"].size());
+        const JsonValue &materialList = document.json["materials"];
+        materials.resize(materialList.size());
+        for (size_t m = 0; m < materialList.size(); m++) {
+            int baseColor = materialList[m]["pbrMetallicRoughness"]["baseColorTexture"]["index"].asInt(-1);
+            int normal = materialList[m]["normalTexture"]["index"].asInt(-1);
+            addTexture(document, baseColor, "texture_diffuse", materials[m]);
+            addTexture(document, normal, "texture_normal", materials[m]);
+        }
+    }
+
+    void addTexture(const GltfDocument &document, int texture, const string &type, vector<Texture> &textures)
+    {
+        if (texture < 0) return;
+        int image = document.json["textures"][texture]["source"].asInt(-1);
+        if (image < 0 || image >= int(imageTextures.size())) return;
+        Texture entry;
+        entry.id = imageTexture(document, image);
+        entry.type = type;
+        entry.path = document.json["images"][image]["uri"].asString();
+        textures.push_back(entry);
+    }
+
+    // images named by a uri go through textureFromFile and its .dds cache, images inside a buffer view are
+    // decoded from the mapped file and block compressed each load
+    GLuint imageTexture(const GltfDocument &document, int image)
+    {
+        if (imageTextures[image]) return imageTextures[image];
+        const JsonValue &info = document.json["images"][image];
+        const string &uri = info["uri"].asString();
+        int view = info["bufferView"].asInt(-1);
+        GLuint textureID;
+        if (!uri.empty() && uri.compare(0, 5, "data:") != 0) {
+            textureID = textureFromFile(uri.c_str(), directory);
+        } else {
+            glGenTextures(1, &textureID);
+            int width, height, nrComponents;
+            unsigned char *data = nullptr;
+            if (view >= 0 && view < int(document.bufferViews.size()))
+                data = stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(document.viewData(view)),
+                                             int(document.bufferViews[view].byteLength), &width, &height, &nrComponents, 0);
+            if (data) {
+                CompressedImage compressed = TextureCompressor::compress(data, width, height, nrComponents,
+                                                                         TextureCompressor::formatFor(nrComponents));
+                stbi_image_free(data);
+                uploadCompressedTexture(textureID, compressed);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            } else {
+                cout << "Texture failed to load from glTF image " << image << endl;
+            }
+        }
+        imageTextures[image] = textureID;
+        return textureID;
+    }
+
+    // the scene's node trees below node 0, parents before children as TransformHierarchy needs
+    void loadNodes(const GltfDocument &document)
+    {
+        const JsonValue &nodeList = document.json["nodes"];
+        const JsonValue &scenes = document.json["scenes"];
+        const JsonValue &roots = scenes[size_t(document.json["scene"].asInt(0))]["nodes"];
+        vector<bool> visited(nodeList.size(), false);
+        for (size_t i = 0; i < roots.size(); i++)
+            addNode(nodeList, roots[i].asInt(-1), 0, visited);
+        if (scenes.size() == 0) // no scene, place the meshes of all root nodes
+            for (size_t i = 0; i < nodeList.size(); i++)
+                if (!visited[i]) addNode(nodeList, int(i), 0, visited);
+    }
+
+    void addNode(const JsonValue &nodeList, int index, int parent, vector<bool> &visited)
+    {
+        if (index < 0 || index >= int(visited.size()) || visited[index]) return; // a cycle or a shared child
+        visited[index] = true;
+        const JsonValue &info = nodeList[size_t(index)];
+        int node;
+        if (info["matrix"].size() == 16) {
+            float matrix[16];
+            for (size_t i = 0; i < 16; i++)
+                matrix[i] = float(info["matrix"][i].asNumber());
+            node = transforms.addNode(parent, glm::make_mat4(matrix), info["name"].asString());
+        } else {
+            const JsonValue &t = info["translation"], &r = info["rotation"], &s = info["scale"];
+            glm::vec3 position(t[size_t(0)].asNumber(), t[1].asNumber(), t[2].asNumber());
+            glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+            if (r.size() == 4) // glTF stores x, y, z, w
+                rotation = glm::quat(float(r[3].asNumber()), float(r[size_t(0)].asNumber()), float(r[1].asNumber()),
+                                     float(r[2].asNumber()));
+            glm::vec3 scale(s[size_t(0)].asNumber(1.0), s[1].asNumber(1.0), s[2].asNumber(1.0));
+            node = transforms.addNode(parent, position, rotation, scale, info["name"].asString());
+        }
+        int mesh = info["mesh"].asInt(-1);
+        if (mesh >= 0 && mesh < int(meshes.size()))
+            instances.push_back({ node, mesh });
+        const JsonValue &children = info["children"];
+        for (size_t i = 0; i < children.size(); i++)
+            addNode(nodeList, children[i].asInt(-1), node, visited);
+    }
+
+    const vector<vector<GLint>> &samplerUnits(Shader &shader)
+    {
+        if (unitsShader == shader.serial && unitsRevision == shader.revision) return units;
+        unitsShader = shader.serial;
+        unitsRevision = shader.revision;
+        units.assign(materials.size(), vector<GLint>());
+        for (size_t m = 0; m < materials.size(); m++)
+            for (const Texture &texture : materials[m]) {
+                GLint unit = shader.samplerUnit(texture.type + "1");
+                if (unit < 0)
+                    unit = shader.samplerUnit("material." + texture.type + "1");
+                units[m].push_back(unit);
+            }
+        return units;
+    }
+};
 
 
 GLuint loadCubemap(vector<std::string> faces) {
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState::bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (int i = 0; i < faces.size(); i++) {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        unsigned char *data = loadImage(faces[i], &width, &height, &nrChannels);
         if (data) {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB,
                          width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
@@ -758,10 +3610,11 @@ public:
     }
 
     void render(const char *textChars, glm::vec2 position, GLfloat scale, glm::vec3 color) {
-        glUseProgram(_program);
-        glUniform3f(glGetUniformLocation(_program, "textColor"), color.r, color.g, color.b);
-        glActiveTexture(GL_TEXTURE0);
-        glBindVertexArray(VAO);
+        GLState::useProgram(_program);
+        glUniform3f(_textColorLocation, color.r, color.g, color.b);
+        GLState::activeTexture(GL_TEXTURE0);
+        GLState::bindVertexArray(VAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
 
         string text(textChars);
         string::const_iterator c;
@@ -780,15 +3633,11 @@ public:
                 {xpos + w, ypos, 1.0, 1.0},
                 {xpos + w, ypos + h, 1.0, 0.0}
             };
-            glBindTexture(GL_TEXTURE_2D, ch.textureID);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            GLState::bindTexture(GL_TEXTURE_2D, ch.textureID);
             glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // not glBufferData
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
             glDrawArrays(GL_TRIANGLES, 0, 6);
             position.x += (ch.advance >> 6) * scale; // advance cursors for next glyph (the unit of advance is 1/64 pixels)
         }
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
     GLuint getPixelSize() {
@@ -804,6 +3653,7 @@ private:
     };
 
     GLuint _program;
+    GLint _textColorLocation;
     glm::vec2 _screen;
     GLuint _pixelSize;
     map<GLchar, Character> _characters;
@@ -812,15 +3662,16 @@ private:
     constexpr static GLuint DEFAULT_PIXEL_SIZE = 48;
 
     void initialize(const char *path) {
-        glEnable(GL_CULL_FACE);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLState::enable(GL_CULL_FACE);
+        GLState::enable(GL_BLEND);
+        GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         FT_Library ft;
         if (FT_Init_FreeType(&ft))
             cout << "ERROR::FREETYPE: Could not init FreeType Library" << endl;
         FT_Face face;
-        if (FT_New_Face(ft, path, 0, &face))
+        AssetFile font(path); // FreeType reads the glyphs below, the file only has to outlive the face
+        if (FT_New_Memory_Face(ft, reinterpret_cast<const FT_Byte *>(font.data()), font.length(), 0, &face))
             cout << "ERROR::FREETYPE: Failed to load font" << endl;
 
         FT_Set_Pixel_Sizes(face, 0, _pixelSize);
@@ -834,7 +3685,7 @@ private:
 
             GLuint texture; // generate textures
             glGenTextures(1, &texture);
-            glBindTexture(GL_TEXTURE_2D, texture);
+            GLState::bindTexture(GL_TEXTURE_2D, texture);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows,
                          0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // options
@@ -850,19 +3701,19 @@ private:
             };
             _characters.insert(pair<GLchar, Character>(i, character));
         }
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::bindTexture(GL_TEXTURE_2D, 0);
         FT_Done_Face(face);
         FT_Done_FreeType(ft);
 
         glGenVertexArrays(1, &VAO); // configure VAO & VBO for texture quads
         glGenBuffers(1, &VBO);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::bindVertexArray(VAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::bindVertexArray(0);
     }
 
     void compileShaders() {
@@ -908,9 +3759,10 @@ private:
         checkCompileErrors(_program, "PROGRAM");
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+        _textColorLocation = glGetUniformLocation(_program, "textColor");
 
         glm::mat4 projection = glm::ortho(0.0f, GLfloat(_screen.x), 0.0f, GLfloat(_screen.y));
-        glUseProgram(_program);
+        GLState::useProgram(_program);
         glUniformMatrix4fv(glGetUniformLocation(_program, "projection"), 1, GL_FALSE, &projection[0][0]);
     }
 
@@ -955,6 +3807,7 @@ public:
             result += to_string(averageFPS).substr(0, _precision + 1);
             result += "  Current FPS: ";
             result += to_string(lastFPS).substr(0, _precision + 1);
+            result += "  GL state calls: " + to_string(_glCalls.issued) + " (" + to_string(_glCalls.elided) + " elided)";
 
             _renderP->render(result.c_str(), glm::vec2(20.0f, 20.0f),
                              GLfloat(_fontSize)/_renderP->getPixelSize(), glm::vec3(1.0));
@@ -962,7 +3815,11 @@ public:
         else cout << "Text Render uninitialized!" << endl;
     }
 
-    void count() { _frameCount++; }
+    // ends the frame, also for GLState's counters, which render shows for the frame before
+    void count() {
+        _frameCount++;
+        _glCalls = GLState::endFrame();
+    }
 
     void run() {
         count();
@@ -974,6 +3831,7 @@ private:
     GLuint _precision;
     GLuint _frameCount = 0;
     float _lastTime = 0;
+    GLState::Counters _glCalls;
     GLuint _fontSize;
     constexpr static GLuint DEFALUT_FONT_SIZE = 14;
 };
@@ -3,20 +3,32 @@
 static const GLsizei width = 1024, height = 576;
 static Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
-static Shader *program;
+// the same shaders built twice, the lighting model is a compile time choice
+static const ShaderSource blinnSource = { "shaders/model/model.vs.glsl", "shaders/model/model.fs.glsl", "", {} };
+static const ShaderSource phongSource = { "shaders/model/model.vs.glsl", "shaders/model/model.fs.glsl", "", { { "PHONG", "" } } };
+static ShaderVariants *variants;
+static ShaderReloader *reloader; // edit the shaders while the demo runs
+static bool phong = false;
 static Model *mitsuba, *cube;
 static TextRenderer *text;
 static FrameCounter *counter;
 
 static void setup() {
-    program = new Shader("shaders/model/model_vertex.glsl", "shaders/model/model_fragment.glsl");
+    variants = new ShaderVariants();
+    variants->prepare({ blinnSource, phongSource }); // both compile at once where the driver allows it
+    reloader = new ShaderReloader();
+    reloader->watch(variants->get(blinnSource));
+    reloader->watch(variants->get(phongSource));
     mitsuba = new Model("resources/mitsuba/mitsuba.obj");
     cube = new Model("resources/cube/cube.obj");
+    cube->transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, 0.0f));
     text = new TextRenderer("resources/IBMPlexMono-Regular.ttf", glm::ivec2(width, height));
     counter = new FrameCounter(text);
 }
 
 static void draw(float time) {
+    reloader->update();
+    Shader *program = &variants->get(phong ? phongSource : blinnSource);
     program->use();
 
     glm::vec3 pointLightPos(1.0f, 2.0f, 1.0f);
@@ -33,23 +45,17 @@ static void draw(float time) {
     program->setVec3("dirLight.diffuse", glm::vec3(0.4f));
     program->setVec3("dirLight.specular", glm::vec3(0.2f));
 
-    glm::mat4 model, view, projection; // view and projection matrices
+    glm::mat4 view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
     program->setMat4("view", view);
     program->setMat4("projection", projection);
 
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model))); // model 1: mitsuba
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    mitsuba->Draw(*program);
-
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f)); // model 2: cube
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    cube->Draw(*program);
+    mitsuba->Draw(*program, view); // sets model and normalMat from the model's transforms
+    cube->Draw(*program, view);
 
+    string mode = phong ? "Phong (B for Blinn-Phong)" : "Blinn-Phong (B for Phong)";
+    text->render(mode.c_str(), glm::vec2(20.0f, 40.0f), 14.0f / text->getPixelSize(), glm::vec3(1.0));
     counter->count();
     counter->render();
 }
@@ -97,6 +103,12 @@ static void processInput(GLFWwindow *window, float time) {
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    static bool switching = false;
+    bool pressed = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (pressed && !switching)
+        phong = !phong;
+    switching = pressed;
 }
 
 int main() {
@@ -118,8 +130,8 @@ int main() {
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_MULTISAMPLE);
     setup();
 
     // Draw
@@ -133,7 +145,8 @@ int main() {
     }
 
     // Terminate
-    delete program;
+    delete reloader;
+    delete variants;
     delete mitsuba;
     delete cube;
     glfwTerminate();
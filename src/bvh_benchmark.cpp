@@ -0,0 +1,182 @@
+// Ray casting throughput of the mesh BVH against brute force. Needs no window or GL context.
+// usage: bvh_benchmark [model ...], run from bin/ like the demos
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "bvh.h"
+
+using namespace std;
+
+static const int IMAGE_SIZE = 512;         // camera rays per view, squared
+static const int VIEW_COUNT = 4;
+static const int RANDOM_RAYS = 1 << 18;    // incoherent rays between random points of the bounds
+static const int BRUTE_FORCE_RAYS = 1 << 12;
+
+static double secondsSince(chrono::high_resolution_clock::time_point start) {
+    return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// all meshes of the file flattened into one triangle soup
+static bool loadTriangles(const string &path, vector<glm::vec3> &positions, vector<unsigned int> &indices) {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+        return false;
+    }
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+        const aiMesh *mesh = scene->mMeshes[m];
+        unsigned int base = positions.size();
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+            positions.push_back(glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z));
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+            if (mesh->mFaces[i].mNumIndices == 3)
+                for (unsigned int j = 0; j < 3; j++)
+                    indices.push_back(base + mesh->mFaces[i].mIndices[j]);
+    }
+    return true;
+}
+
+static RayHit bruteForce(const Ray &ray, const vector<glm::vec3> &positions, const vector<unsigned int> &indices) {
+    RayHit hit;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::vec3 v0 = positions[indices[i]];
+        glm::vec3 e1 = positions[indices[i + 1]] - v0, e2 = positions[indices[i + 2]] - v0;
+        glm::vec3 p = glm::cross(ray.direction, e2);
+        float det = glm::dot(e1, p);
+        if (std::abs(det) < 1e-12f) continue;
+        float invDet = 1.0f / det;
+        glm::vec3 s = ray.origin - v0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) continue;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(ray.direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) continue;
+        float t = glm::dot(e2, q) * invDet;
+        if (t > 0.0f && t < hit.t) {
+            hit.t = t;
+            hit.u = u;
+            hit.v = v;
+            hit.triangle = i / 3;
+        }
+    }
+    return hit;
+}
+
+// pinhole camera rays looking at the bounds from VIEW_COUNT directions, in 2x2 pixel quads so packets are coherent
+static vector<Ray> cameraRays(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - boundsMin) * 0.5f;
+    vector<Ray> rays;
+    rays.reserve(VIEW_COUNT * IMAGE_SIZE * IMAGE_SIZE);
+    for (int view = 0; view < VIEW_COUNT; view++) {
+        float angle = 6.2831853f * view / VIEW_COUNT;
+        glm::vec3 eye = center + glm::vec3(std::sin(angle), 0.3f, std::cos(angle)) * radius * 2.5f;
+        glm::vec3 forward = glm::normalize(center - eye);
+        glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        glm::vec3 up = glm::cross(right, forward);
+        for (int y = 0; y < IMAGE_SIZE; y += 2)
+            for (int x = 0; x < IMAGE_SIZE; x += 2)
+                for (int k = 0; k < 4; k++) {
+                    float sx = (x + (k & 1) + 0.5f) / IMAGE_SIZE * 2.0f - 1.0f;
+                    float sy = (y + (k >> 1) + 0.5f) / IMAGE_SIZE * 2.0f - 1.0f;
+                    rays.push_back(Ray(eye, glm::normalize(forward + (right * sx + up * sy) * 0.45f)));
+                }
+    }
+    return rays;
+}
+
+static vector<Ray> randomRays(glm::vec3 boundsMin, glm::vec3 boundsMax) {
+    mt19937 generator(7);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto randomPoint = [&]() {
+        return boundsMin + (boundsMax - boundsMin) * glm::vec3(unit(generator), unit(generator), unit(generator));
+    };
+    vector<Ray> rays(RANDOM_RAYS);
+    for (Ray &ray : rays) {
+        glm::vec3 from = randomPoint();
+        ray = Ray(from, glm::normalize(randomPoint() - from));
+    }
+    return rays;
+}
+
+static void report(const char *name, size_t rays, double seconds, size_t hits) {
+    cout << "  " << left << setw(22) << name << right << fixed << setprecision(3) << setw(10)
+         << rays / seconds * 1e-6 << " Mrays/s  " << setw(8) << hits << " hits" << endl;
+}
+
+static void benchmark(const char *name, const BVH &bvh, const vector<Ray> &rays,
+                      const vector<glm::vec3> &positions, const vector<unsigned int> &indices) {
+    cout << " " << name << " rays:" << endl;
+    vector<RayHit> hits(rays.size());
+
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < rays.size(); i++)
+        bvh.intersect(rays[i], hits[i]);
+    double scalarTime = secondsSince(start);
+    size_t scalarHits = count_if(hits.begin(), hits.end(), [](const RayHit &hit) { return hit.hit(); });
+    report("BVH single ray", rays.size(), scalarTime, scalarHits);
+
+    vector<RayHit> packetHits(rays.size());
+    start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i + 4 <= rays.size(); i += 4)
+        bvh.intersectPacket(&rays[i], &packetHits[i]);
+    double packetTime = secondsSince(start);
+    size_t packetHitCount = count_if(packetHits.begin(), packetHits.end(), [](const RayHit &hit) { return hit.hit(); });
+#ifdef BVH_SSE
+    report("BVH 4-ray SSE packet", rays.size(), packetTime, packetHitCount);
+#else
+    report("BVH 4-ray packet", rays.size(), packetTime, packetHitCount);
+#endif
+
+    // brute force on a strided subset, which also checks the BVH answers
+    size_t step = std::max<size_t>(1, rays.size() / BRUTE_FORCE_RAYS), tested = 0, mismatches = 0, bruteHits = 0;
+    start = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < rays.size(); i += step, tested++) {
+        RayHit hit = bruteForce(rays[i], positions, indices);
+        bruteHits += hit.hit();
+        if (hit.hit() != hits[i].hit() || hit.hit() != packetHits[i].hit()
+                || (hit.hit() && (std::abs(hit.t - hits[i].t) > 1e-4f * hit.t || std::abs(hit.t - packetHits[i].t) > 1e-4f * hit.t)))
+            mismatches++;
+    }
+    report("brute force", tested, secondsSince(start), bruteHits);
+    if (mismatches > 0)
+        cout << "  WARNING: " << mismatches << " of " << tested << " rays disagree with brute force" << endl;
+}
+
+int main(int argc, char **argv) {
+    vector<string> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+        paths = { "resources/nanosuit/nanosuit.obj", "resources/mitsuba/mitsuba.obj", "resources/teapot/teapot.obj" };
+
+    for (const string &path : paths) {
+        vector<glm::vec3> positions;
+        vector<unsigned int> indices;
+        if (!loadTriangles(path, positions, indices) || indices.empty())
+            continue;
+
+        BVH bvh;
+        auto start = chrono::high_resolution_clock::now();
+        bvh.build(indices, &positions[0].x, sizeof(glm::vec3));
+        double buildTime = secondsSince(start);
+        cout << path << ": " << indices.size() / 3 << " triangles, " << bvh.nodeCount() << " nodes built in "
+             << fixed << setprecision(1) << buildTime * 1000.0 << " ms on " << workerCount() << " threads" << endl;
+
+        glm::vec3 boundsMin = positions[0], boundsMax = positions[0];
+        for (const glm::vec3 &position : positions) {
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+        benchmark("camera", bvh, cameraRays(boundsMin, boundsMax), positions, indices);
+        benchmark("random", bvh, randomRays(boundsMin, boundsMax), positions, indices);
+    }
+    return 0;
+}
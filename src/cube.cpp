@@ -54,7 +54,7 @@ static Shader *program;
 
 static void loadTexture(const char *location, GLuint &texture, bool flip) {
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    GLState::bindTexture(GL_TEXTURE_2D, texture);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // set texture wrapping options
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -80,7 +80,7 @@ static void setup() {
     glGenVertexArrays(1, &VAO); // vertex attribute object
     glGenBuffers(1, &VBO); // vetex buffer object
     // glGenBuffers(1, &EBO); // element buffer object
-    glBindVertexArray(VAO);
+    GLState::bindVertexArray(VAO);
 
     loadTexture("resources/container.jpg", tex1, false);
     loadTexture("resources/frog.jpg", tex2, true);
@@ -89,7 +89,7 @@ static void setup() {
     program->setInt("texture1", 0);
     program->setInt("texture2", 1);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
@@ -98,10 +98,10 @@ static void setup() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*) (3 * sizeof(float)) );
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 
-    glEnable(GL_DEPTH_TEST);
+    GLState::enable(GL_DEPTH_TEST);
 }
 
 static void draw(float time) {
@@ -114,13 +114,13 @@ static void draw(float time) {
     program->setMat4("view", view);
     program->setMat4("projection", projection);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tex1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, tex2);
-    glBindVertexArray(VAO);
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, tex1);
+    GLState::activeTexture(GL_TEXTURE1);
+    GLState::bindTexture(GL_TEXTURE_2D, tex2);
+    GLState::bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -200,9 +200,9 @@ int cube() {
 
     // Terminate
     delete program;
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    GLState::deleteVertexArrays(1, &VAO);
+    GLState::deleteBuffers(1, &VBO);
+    GLState::deleteBuffers(1, &EBO);
     glfwTerminate();
     return 0;
 }
@@ -14,6 +14,7 @@ static void setup() {
     skybox = new Shader("shaders/skybox/skybox.vs.glsl", "shaders/skybox/skybox.fs.glsl");
     // mitsuba = new Model("resources/mitsuba/mitsuba.obj");
     // cube = new Model("resources/cube/cube.obj");
+    // cube->transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, 0.0f));
     nanosuit = new Model("resources/nanosuit/nanosuit.obj");
 
     std::string skybox_path = "resources/skybox/"; // load skybox faces
@@ -29,44 +30,36 @@ static void setup() {
 
     glGenVertexArrays(1, &skyboxVAO); // skybox vertex array
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    GLState::bindVertexArray(skyboxVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(SKYBOX_VERTICES), SKYBOX_VERTICES, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 }
 
 static void draw(float time) {
     program->use();
-    glm::mat4 model, view, projection; // view and projection matrices
+    glm::mat4 view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
     program->setMat4("view", view);
     program->setMat4("projection", projection);
 
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model))); // model: mitsuba
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    // mitsuba->Draw(*program);
-    nanosuit->Draw(*program);
+    // mitsuba->Draw(*program, view); // sets model and normalMat from the model's transforms
+    nanosuit->Draw(*program, view);
+    // cube->Draw(*program, view);
 
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f)); // model: cube
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    // cube->Draw(*program);
-
-    glDepthFunc(GL_LEQUAL);
+    GLState::depthFunc(GL_LEQUAL);
     skybox->use(); // skybox
     skybox->setMat4("view", glm::mat4(glm::mat3(view)));
     skybox->setMat4("projection", projection);
-    glBindVertexArray(skyboxVAO);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    GLState::bindVertexArray(skyboxVAO);
+    GLState::bindTextureUnit(0, GL_TEXTURE_CUBE_MAP, cubemap);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS);
+    GLState::bindVertexArray(0);
+    GLState::depthFunc(GL_LESS);
 }
 
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -137,7 +130,7 @@ int drawModel() {
     // Draw
     while (!glfwWindowShouldClose(window)) {
         processInput(window, glfwGetTime());
-        glEnable(GL_DEPTH_TEST);
+        GLState::enable(GL_DEPTH_TEST);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         draw(glfwGetTime());
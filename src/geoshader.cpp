@@ -12,6 +12,7 @@ static void setup() {
                       "shaders/geoshader/norm.gs.glsl");
     mitsuba = new Model("resources/mitsuba/mitsuba.obj");
     cube = new Model("resources/cube/cube.obj");
+    cube->transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, 0.0f));
 }
 
 static void draw(float time) {
@@ -31,36 +32,20 @@ static void draw(float time) {
     program->setVec3("dirLight.diffuse", glm::vec3(0.4f));
     program->setVec3("dirLight.specular", glm::vec3(0.2f));
 
-    glm::mat4 model, view, projection; // view and projection matrices
+    glm::mat4 view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
     program->setMat4("view", view);
     program->setMat4("projection", projection);
 
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model))); // model 1: mitsuba
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    mitsuba->Draw(*program);
-
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f)); // model 2: cube
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    cube->Draw(*program);
+    mitsuba->Draw(*program, view); // sets model and normalMat from the model's transforms
+    cube->Draw(*program, view);
 
     norm->use(); // draw again in another program with geometry shader
     norm->setMat4("view", view);
     norm->setMat4("projection", projection);
-    model = glm::mat4();
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    norm->setMat4("model", model);
-    norm->setMat3("normalMat", normalMat);
-    mitsuba->Draw(*norm);
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f));
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    norm->setMat4("model", model);
-    norm->setMat3("normalMat", normalMat);
-    cube->Draw(*norm);
+    mitsuba->Draw(*norm, view);
+    cube->Draw(*norm, view);
 }
 
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -131,7 +116,7 @@ int main() {
     // Draw
     while (!glfwWindowShouldClose(window)) {
         processInput(window, glfwGetTime());
-        glEnable(GL_DEPTH_TEST);
+        GLState::enable(GL_DEPTH_TEST);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         draw(glfwGetTime());
@@ -8,8 +8,19 @@ static Model *planet, *rock;
 static TextRenderer *text;
 static FrameCounter *counter;
 static glm::mat4 *modelMatrices;
+static vector<glm::mat4> lodMatrices; // modelMatrices grouped by LOD, rebuilt every frame
+static GLuint instanceBuffer;
 static GLuint ASTEROID_AMOUNT = 20000;
 
+static void setInstanceOffset(GLuint firstInstance) { // instance matrices start at firstInstance
+    GLuint vec4Size = sizeof(glm::vec4);
+    size_t offset = firstInstance * sizeof(glm::mat4);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)offset);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(offset + vec4Size));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(offset + 2 * vec4Size));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(offset + 3 * vec4Size));
+}
+
 static void setup() {
     program = new Shader("shaders/instance/instance.vs.glsl", "shaders/instance/instance.fs.glsl");
     rock = new Model("resources/rock/rock.obj");
@@ -42,30 +53,58 @@ static void setup() {
         modelMatrices[i] = model;
     }
 
-    GLuint buffer;
-    glGenBuffers(1, &buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, ASTEROID_AMOUNT * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
+    lodMatrices.resize(ASTEROID_AMOUNT);
+    glGenBuffers(1, &instanceBuffer);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, ASTEROID_AMOUNT * sizeof(glm::mat4), &modelMatrices[0], GL_STREAM_DRAW);
     for (int i = 0; i < rock->meshes.size(); i++) {
         GLuint VAO = rock->meshes[i].VAO;
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
 
-        GLuint vec4Size = sizeof(glm::vec4);
-        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, 0);
+        setInstanceOffset(0);
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)vec4Size);
         glEnableVertexAttribArray(3);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
         glEnableVertexAttribArray(4);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
         glEnableVertexAttribArray(5);
 
         glVertexAttribDivisor(2, 1);
         glVertexAttribDivisor(3, 1);
         glVertexAttribDivisor(4, 1);
         glVertexAttribDivisor(5, 1);
-        glBindVertexArray(0);
+        GLState::bindVertexArray(0);
+    }
+}
+
+static void drawInstancedLods(Mesh &mesh, const ViewInfo &viewInfo) {
+    static vector<GLuint> instanceLods;
+    instanceLods.resize(ASTEROID_AMOUNT);
+    GLuint culled = mesh.lods.size(); // extra bucket for instances outside the frustum
+    vector<GLuint> firstInstance(mesh.lods.size() + 2, 0);
+    for (GLuint i = 0; i < ASTEROID_AMOUNT; i++) { // counting sort of the instances by LOD
+        bool visible = mesh.isVisible(modelMatrices[i], viewInfo.frustum);
+        instanceLods[i] = visible ? mesh.selectLod(modelMatrices[i], viewInfo) : culled;
+        firstInstance[instanceLods[i] + 1]++;
+    }
+    for (GLuint lod = 0; lod < culled; lod++)
+        firstInstance[lod + 1] += firstInstance[lod];
+    vector<GLuint> next(firstInstance.begin(), firstInstance.end() - 1);
+    for (GLuint i = 0; i < ASTEROID_AMOUNT; i++)
+        if (instanceLods[i] != culled)
+            lodMatrices[next[instanceLods[i]]++] = modelMatrices[i];
+
+    GLuint visibleCount = firstInstance[culled];
+    GLState::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, ASTEROID_AMOUNT * sizeof(glm::mat4), NULL, GL_STREAM_DRAW); // orphan
+    if (visibleCount > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(glm::mat4), &lodMatrices[0]);
+    for (GLuint lod = 0; lod < mesh.lods.size(); lod++) {
+        GLsizei count = firstInstance[lod + 1] - firstInstance[lod];
+        if (count == 0) continue;
+        GLState::bindVertexArray(mesh.VAO);
+        setInstanceOffset(firstInstance[lod]);
+        mesh.DrawInstanced(lod, count);
     }
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 static void draw(float time) {
@@ -78,12 +117,11 @@ static void draw(float time) {
 
     program->use();
     program->setInt("material.texture_diffuse1", 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, rock->textures_loaded[0].id);
-    for (int i = 0; i < rock->meshes.size(); i++) {
-        glBindVertexArray(rock->meshes[i].VAO);
-        glDrawElementsInstanced(GL_TRIANGLES, rock->meshes[i].indices.size(), GL_UNSIGNED_INT, 0, ASTEROID_AMOUNT);
-    }
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, rock->textures_loaded[0].id);
+    ViewInfo viewInfo(view, projection, height);
+    for (int i = 0; i < rock->meshes.size(); i++)
+        drawInstancedLods(rock->meshes[i], viewInfo);
 
     counter->count();
     counter->render();
@@ -147,7 +185,7 @@ int main() {
     // Draw
     while (!glfwWindowShouldClose(window)) {
         processInput(window, glfwGetTime());
-        glEnable(GL_DEPTH_TEST);
+        GLState::enable(GL_DEPTH_TEST);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         draw(glfwGetTime());
@@ -71,15 +71,21 @@ static glm::vec3 pointLightPositions[] = {
 
 static GLuint objectVAO, lightVAO, VBO, diffuseMap, specularMap;
 static Shader *lighting, *lamp;
+static ShaderReloader *reloader; // edit the shaders while the demo runs
+static TransformHierarchy transforms; // the cubes, then the lamps. None of them move after setup
 
 static void setup() {
-    lighting = new Shader("shaders/light/lighting_vertex.glsl", "shaders/light/lighting_fragment.glsl");
+    lighting = new Shader(ShaderSource{ "shaders/light/lighting_vertex.glsl", "shaders/light/lighting_fragment.glsl", "",
+                                        { { "NR_POINT_LIGHTS", to_string(sizeof(pointLightPositions) / sizeof(pointLightPositions[0])) } } });
     lamp = new Shader("shaders/light/lamp_vertex.glsl", "shaders/light/lamp_fragment.glsl");
+    reloader = new ShaderReloader();
+    reloader->watch(*lighting);
+    reloader->watch(*lamp);
 
     glGenVertexArrays(1, &objectVAO); // vertex attribute object
     glGenBuffers(1, &VBO); // vetex buffer object
-    glBindVertexArray(objectVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindVertexArray(objectVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof (float), 0);
     glEnableVertexAttribArray(0);
@@ -87,16 +93,16 @@ static void setup() {
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof (float), (void*) (6 * sizeof (float)) );
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 
     glGenVertexArrays(1, &lightVAO);
-    glBindVertexArray(lightVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindVertexArray(lightVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof (float), 0);
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 
     loadTexture("resources/container2.jpg", diffuseMap, false);
     loadTexture("resources/container2_specular.jpg", specularMap, false);
@@ -104,95 +110,96 @@ static void setup() {
     lighting->setInt("material.diffuse", 0);
     lighting->setInt("material.specular", 1);
 
-    glEnable(GL_DEPTH_TEST);
+    for (int i = 0; i < 10; i++) {
+        float angle = 20.0f * i;
+        transforms.addNode(-1, cubePositions[i], glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f))));
+    }
+    for (int i = 0; i < 4; i++)
+        transforms.addNode(-1, pointLightPositions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f)); // smaller cubes
+    transforms.update();
+
+    GLState::enable(GL_DEPTH_TEST);
 }
 
 static void draw(float time) {
+    reloader->update();
     lighting->use(); // draw lighting effect
-    glm::mat4 model, view, projection;
+    glm::mat4 view, projection;
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width)/height, 0.1f, 100.0f);
-    lighting->setMat4("view", view);
-    lighting->setMat4("projection", projection);
-    lighting->setFloat("material.shininess", 32.0f);
-
-    lighting->setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-    lighting->setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-    lighting->setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-    lighting->setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+    lighting->setMat4("view"_u, view);
+    lighting->setMat4("projection"_u, projection);
+    lighting->setFloat("material.shininess"_u, 32.0f);
+
+    lighting->setVec3("dirLight.direction"_u, -0.2f, -1.0f, -0.3f);
+    lighting->setVec3("dirLight.ambient"_u, 0.05f, 0.05f, 0.05f);
+    lighting->setVec3("dirLight.diffuse"_u, 0.4f, 0.4f, 0.4f);
+    lighting->setVec3("dirLight.specular"_u, 0.5f, 0.5f, 0.5f);
     // point light 1
-    lighting->setVec3("pointLights[0].position", pointLightPositions[0]);
-    lighting->setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-    lighting->setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-    lighting->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-    lighting->setFloat("pointLights[0].constant", 1.0f);
-    lighting->setFloat("pointLights[0].linear", 0.09f);
-    lighting->setFloat("pointLights[0].quadratic", 0.032f);
+    lighting->setVec3("pointLights[0].position"_u, pointLightPositions[0]);
+    lighting->setVec3("pointLights[0].ambient"_u, 0.05f, 0.05f, 0.05f);
+    lighting->setVec3("pointLights[0].diffuse"_u, 0.8f, 0.8f, 0.8f);
+    lighting->setVec3("pointLights[0].specular"_u, 1.0f, 1.0f, 1.0f);
+    lighting->setFloat("pointLights[0].constant"_u, 1.0f);
+    lighting->setFloat("pointLights[0].linear"_u, 0.09f);
+    lighting->setFloat("pointLights[0].quadratic"_u, 0.032f);
     // point light 2
-    lighting->setVec3("pointLights[1].position", pointLightPositions[1]);
-    lighting->setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-    lighting->setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-    lighting->setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-    lighting->setFloat("pointLights[1].constant", 1.0f);
-    lighting->setFloat("pointLights[1].linear", 0.09f);
-    lighting->setFloat("pointLights[1].quadratic", 0.032f);
+    lighting->setVec3("pointLights[1].position"_u, pointLightPositions[1]);
+    lighting->setVec3("pointLights[1].ambient"_u, 0.05f, 0.05f, 0.05f);
+    lighting->setVec3("pointLights[1].diffuse"_u, 0.8f, 0.8f, 0.8f);
+    lighting->setVec3("pointLights[1].specular"_u, 1.0f, 1.0f, 1.0f);
+    lighting->setFloat("pointLights[1].constant"_u, 1.0f);
+    lighting->setFloat("pointLights[1].linear"_u, 0.09f);
+    lighting->setFloat("pointLights[1].quadratic"_u, 0.032f);
     // point light 3
-    lighting->setVec3("pointLights[2].position", pointLightPositions[2]);
-    lighting->setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-    lighting->setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-    lighting->setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-    lighting->setFloat("pointLights[2].constant", 1.0f);
-    lighting->setFloat("pointLights[2].linear", 0.09f);
-    lighting->setFloat("pointLights[2].quadratic", 0.032f);
+    lighting->setVec3("pointLights[2].position"_u, pointLightPositions[2]);
+    lighting->setVec3("pointLights[2].ambient"_u, 0.05f, 0.05f, 0.05f);
+    lighting->setVec3("pointLights[2].diffuse"_u, 0.8f, 0.8f, 0.8f);
+    lighting->setVec3("pointLights[2].specular"_u, 1.0f, 1.0f, 1.0f);
+    lighting->setFloat("pointLights[2].constant"_u, 1.0f);
+    lighting->setFloat("pointLights[2].linear"_u, 0.09f);
+    lighting->setFloat("pointLights[2].quadratic"_u, 0.032f);
     // point light 4
-    lighting->setVec3("pointLights[3].position", pointLightPositions[3]);
-    lighting->setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-    lighting->setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-    lighting->setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-    lighting->setFloat("pointLights[3].constant", 1.0f);
-    lighting->setFloat("pointLights[3].linear", 0.09f);
-    lighting->setFloat("pointLights[3].quadratic", 0.032f);
+    lighting->setVec3("pointLights[3].position"_u, pointLightPositions[3]);
+    lighting->setVec3("pointLights[3].ambient"_u, 0.05f, 0.05f, 0.05f);
+    lighting->setVec3("pointLights[3].diffuse"_u, 0.8f, 0.8f, 0.8f);
+    lighting->setVec3("pointLights[3].specular"_u, 1.0f, 1.0f, 1.0f);
+    lighting->setFloat("pointLights[3].constant"_u, 1.0f);
+    lighting->setFloat("pointLights[3].linear"_u, 0.09f);
+    lighting->setFloat("pointLights[3].quadratic"_u, 0.032f);
     // spotLight
-    lighting->setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-    lighting->setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-    lighting->setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-    lighting->setFloat("spotLight.constant", 1.0f);
-    lighting->setFloat("spotLight.linear", 0.09f);
-    lighting->setFloat("spotLight.quadratic", 0.032f);
-    lighting->setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-    lighting->setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-    glBindVertexArray(objectVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, diffuseMap);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, specularMap);
+    lighting->setVec3("spotLight.ambient"_u, 0.0f, 0.0f, 0.0f);
+    lighting->setVec3("spotLight.diffuse"_u, 1.0f, 1.0f, 1.0f);
+    lighting->setVec3("spotLight.specular"_u, 1.0f, 1.0f, 1.0f);
+    lighting->setFloat("spotLight.constant"_u, 1.0f);
+    lighting->setFloat("spotLight.linear"_u, 0.09f);
+    lighting->setFloat("spotLight.quadratic"_u, 0.032f);
+    lighting->setFloat("spotLight.cutOff"_u, glm::cos(glm::radians(12.5f)));
+    lighting->setFloat("spotLight.outerCutOff"_u, glm::cos(glm::radians(15.0f)));
+
+    GLState::bindVertexArray(objectVAO);
+    GLState::activeTexture(GL_TEXTURE0);
+    GLState::bindTexture(GL_TEXTURE_2D, diffuseMap);
+    GLState::activeTexture(GL_TEXTURE1);
+    GLState::bindTexture(GL_TEXTURE_2D, specularMap);
     // glDrawArrays(GL_TRIANGLES, 0, 36);
     for (int i = 0; i < 10; i++) {
-        float angle = 20.0f * i;
-        model = glm::mat4();
-        model = glm::translate(model, cubePositions[i]);
-        model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-        lighting->setMat4("model", model);
-        glm::mat3 normalMat(glm::transpose(glm::inverse(view * model)));
-        lighting->setMat3("normalMat", normalMat);
+        lighting->setMat4("model"_u, transforms.world(i));
+        lighting->setMat3("normalMat"_u, glm::mat3(view) * transforms.normal(i));
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 
     lamp->use();
-    lamp->setMat4("view", view);
-    lamp->setMat4("projection", projection);
-    glBindVertexArray(lightVAO);
+    lamp->setMat4("view"_u, view);
+    lamp->setMat4("projection"_u, projection);
+    GLState::bindVertexArray(lightVAO);
     for (int i = 0; i < 4; i++)
     {
-        model = glm::mat4();
-        model = glm::translate(model, pointLightPositions[i]);
-        model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-        lamp->setMat4("model", model);
+        lamp->setMat4("model"_u, transforms.world(10 + i));
         glDrawArrays(GL_TRIANGLES, 0, 36);
     }
-    glBindVertexArray(0);
+    GLState::bindVertexArray(0);
 }
 
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -271,11 +278,12 @@ int light() {
     }
 
     // Terminate
+    delete reloader;
     delete lighting;
     delete lamp;
-    glDeleteVertexArrays(1, &objectVAO);
-    glDeleteVertexArrays(1, &lightVAO);
-    glDeleteBuffers(1, &VBO);
+    GLState::deleteVertexArrays(1, &objectVAO);
+    GLState::deleteVertexArrays(1, &lightVAO);
+    GLState::deleteBuffers(1, &VBO);
     glfwTerminate();
     return 0;
 }
@@ -19,23 +19,23 @@ static void setup() {
 
     glGenVertexArrays(1, &mandVAO); // main mandelbrot view
     glGenBuffers(1, &mandVBO);
-    glBindVertexArray(mandVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, mandVBO);
+    GLState::bindVertexArray(mandVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, mandVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(SCREEN_VERTICES), SCREEN_VERTICES, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 
     glGenVertexArrays(1, &juliaVAO);
     glGenBuffers(1, &juliaVBO);
-    glBindVertexArray(juliaVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, juliaVBO);
+    GLState::bindVertexArray(juliaVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, juliaVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(UP_RIGHT_SCREEN_VERTICES), UP_RIGHT_SCREEN_VERTICES, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 }
 
 static void draw(float time) {
@@ -44,7 +44,7 @@ static void draw(float time) {
     transform = view.getViewMatrix();
     inverse = glm::inverse(transform);
     mandelbrot->setDMat4("invMat", inverse);
-    glBindVertexArray(mandVAO);
+    GLState::bindVertexArray(mandVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
     julia->use();
@@ -54,7 +54,7 @@ static void draw(float time) {
     inverse = glm::inverse(transform);
     julia->setDMat4("invMat", inverse);
     julia->setDVec2("origin", view.getOrigin());
-    glBindVertexArray(juliaVAO);
+    GLState::bindVertexArray(juliaVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
     counter->count();
@@ -0,0 +1,147 @@
+#include "utilities.h"
+
+// nanosuit twice, with its textures as separate 2D textures and packed into texture arrays,
+// to compare the draw calls of the two
+static const GLsizei width = 1024, height = 576;
+static Camera camera(glm::vec3(0.0f, 8.0f, 20.0f));
+
+static Shader *program, *arrayProgram;
+static Model *separate, *batched;
+static TextRenderer *text;
+static FrameCounter *counter;
+
+static void setup() {
+    program = new Shader("shaders/model/model.vs.glsl", "shaders/model/model.fs.glsl");
+    arrayProgram = new Shader("shaders/model/model.vs.glsl", "shaders/model/model_array.fs.glsl");
+    separate = new Model("resources/nanosuit/nanosuit.obj");
+    separate->transforms.setPosition(0, glm::vec3(-5.0f, 0.0f, 0.0f));
+    ModelOptions options;
+    options.textureArrays = true; // one multi-draw for every mesh whose textures share sizes and formats
+    batched = new Model("resources/nanosuit/nanosuit.obj", false, options);
+    batched->transforms.setPosition(0, glm::vec3(5.0f, 0.0f, 0.0f));
+    text = new TextRenderer("resources/IBMPlexMono-Regular.ttf", glm::ivec2(width, height));
+    counter = new FrameCounter(text);
+}
+
+static void setLighting(Shader &shader, const glm::mat4 &view, const glm::mat4 &projection) {
+    shader.use();
+    shader.setFloat("material.shininess", 32.0f);
+    shader.setVec3("pointLight.position", glm::vec3(0.0f, 10.0f, 5.0f));
+    shader.setVec3("pointLight.ambient", glm::vec3(0.1f));
+    shader.setVec3("pointLight.diffuse", glm::vec3(0.8f));
+    shader.setVec3("pointLight.specular", glm::vec3(0.7f));
+    shader.setFloat("pointLight.constant", 1.0f);
+    shader.setFloat("pointLight.linear", 0.09f);
+    shader.setFloat("pointLight.quadratic", 0.032f);
+    shader.setVec3("dirLight.direction", 2.0f, -1.0f, -1.0f);
+    shader.setVec3("dirLight.ambient", glm::vec3(0.05f));
+    shader.setVec3("dirLight.diffuse", glm::vec3(0.4f));
+    shader.setVec3("dirLight.specular", glm::vec3(0.2f));
+    shader.setMat4("view", view);
+    shader.setMat4("projection", projection);
+}
+
+static void draw(float time) {
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
+    ViewInfo viewInfo(view, projection, height);
+
+    DrawStats separateStats, batchedStats;
+    setLighting(*program, view, projection);
+    separate->Draw(*program, viewInfo, &separateStats);
+    setLighting(*arrayProgram, view, projection);
+    batched->Draw(*arrayProgram, viewInfo, &batchedStats);
+
+    counter->count();
+    counter->render();
+    string calls = "Draw calls, 2D textures: " + to_string(separateStats.drawCalls)
+                 + "  texture arrays: " + to_string(batchedStats.drawCalls);
+    text->render(calls.c_str(), glm::vec2(20.0f, 40.0f), 14.0f / text->getPixelSize(), glm::vec3(1.0));
+}
+
+static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+    static float lastX = width / 2.0f, lastY = height / 2.0f;
+    static bool firstMouse = true;
+
+    if (firstMouse) {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    camera.ProcessMouseScroll(yoffset);
+}
+
+static void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+    glViewport(0, 0, width, height);
+}
+
+static void processInput(GLFWwindow *window, float time) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    static float deltaTime = 0.0f, lastFrame = 0.0f;
+    deltaTime = time - lastFrame;
+    lastFrame = time;
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+int main() {
+    // Initialization
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow* window = glfwCreateWindow(width, height, "OpenGL program", NULL, NULL); // window hint first, then create
+    if (!window) {
+        std::cout << "Failed to create an GLFW window. " << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_MULTISAMPLE);
+    setup();
+
+    // Draw
+    while (!glfwWindowShouldClose(window)) {
+        processInput(window, glfwGetTime());
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        draw(glfwGetTime());
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    // Terminate
+    delete program;
+    delete arrayProgram;
+    delete separate;
+    delete batched;
+    glfwTerminate();
+    return 0;
+}
@@ -4,19 +4,40 @@ static const GLsizei width = 1024, height = 576;
 static Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
 static Shader *program;
-static Model *mitsuba, *cube;
+static ShaderReloader *reloader; // edit the shaders while the demo runs
+static shared_ptr<Model> mitsuba, cube;
+static vector<ModelInstance> cubes;
 static TextRenderer *text;
 static FrameCounter *counter;
+static shared_ptr<TextureStreamer> streamer;
 
 static void setup() {
-    program = new Shader("shaders/model/model.vs.glsl", "shaders/model/model.fs.glsl");
-    mitsuba = new Model("resources/mitsuba/mitsuba.obj");
-    cube = new Model("resources/cube/cube.obj");
+    AssetPack::mount("assets.pack"); // built by pack_assets, files are read from disk without it
+    program = new Shader("shaders/model/model_packed.vs.glsl", "shaders/model/model.fs.glsl");
+    reloader = new ShaderReloader();
+    reloader->watch(*program);
+    ModelOptions options;
+    options.format = VERTEX_PACKED;
+    options.geometry = make_shared<GeometryBuffer>(VERTEX_PACKED); // both models in one VAO
+    options.keepMeshData = false;
+    options.buildBvh = true; // picking
+    options.clusterCulling = true;
+    options.objLoader = true; // skip Assimp for .obj files
+    streamer = make_shared<TextureStreamer>(size_t(64) << 20); // fine mips stream in as the models come close
+    options.textureStreamer = streamer;
+    mitsuba = ModelRegistry::load("resources/mitsuba/mitsuba.obj", false, options);
+    cube = ModelRegistry::load("resources/cube/cube.obj", false, options);
+    cube->transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, 0.0f));
+    for (int i = 1; i <= 3; i++) { // a row of cubes behind the first, all drawing its meshes
+        cubes.push_back(ModelRegistry::instance("resources/cube/cube.obj", false, options));
+        cubes.back().transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, -2.5f * i));
+    }
     text = new TextRenderer("resources/IBMPlexMono-Regular.ttf", glm::ivec2(width, height));
     counter = new FrameCounter(text);
 }
 
 static void draw(float time) {
+    reloader->update();
     program->use();
 
     glm::vec3 pointLightPos(1.0f, 2.0f, 1.0f);
@@ -32,27 +53,29 @@ static void draw(float time) {
     program->setVec3("dirLight.ambient", glm::vec3(0.05f));
     program->setVec3("dirLight.diffuse", glm::vec3(0.4f));
     program->setVec3("dirLight.specular", glm::vec3(0.2f));
-    program->setBool("useBlinn", true);
 
-    glm::mat4 model, view, projection; // view and projection matrices
+    glm::mat4 view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
     program->setMat4("view", view);
     program->setMat4("projection", projection);
+    ViewInfo viewInfo(view, projection, height);
 
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model))); // model 1: mitsuba
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    mitsuba->Draw(*program);
-
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f)); // model 2: cube
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    cube->Draw(*program);
+    DrawStats stats; // model and normalMat come from the models' transforms
+    mitsuba->Draw(*program, viewInfo, &stats);
+    cube->Draw(*program, viewInfo, &stats);
+    for (ModelInstance &instance : cubes)
+        instance.Draw(*program, viewInfo, &stats);
+    streamer->update(); // reads the mips the draws asked for
 
     counter->count();
     counter->render();
+    string culling = "Meshes drawn: " + to_string(stats.drawn) + "  culled: " + to_string(stats.culled)
+                   + "  Clusters drawn: " + to_string(stats.clustersDrawn) + "  culled: " + to_string(stats.clustersCulled);
+    text->render(culling.c_str(), glm::vec2(20.0f, 40.0f), 14.0f / text->getPixelSize(), glm::vec3(1.0));
+    string streaming = "Streamed mips: " + to_string(streamer->streamedBytes() >> 10) + " / "
+                     + to_string(streamer->budgetBytes() >> 10) + " KiB  reads: " + to_string(streamer->pendingReads());
+    text->render(streaming.c_str(), glm::vec2(20.0f, 60.0f), 14.0f / text->getPixelSize(), glm::vec3(1.0));
 }
 
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -82,6 +105,23 @@ static void framebuffer_size_callback(GLFWwindow *window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
+// casts a ray from the crosshair and reports what it hits
+static void pick() {
+    ModelHit hit;
+    const char *picked = nullptr;
+    if (mitsuba->raycast(camera.Position, camera.Front, hit))
+        picked = "mitsuba";
+    if (cube->raycast(camera.Position, camera.Front, hit))
+        picked = "cube";
+    for (ModelInstance &instance : cubes)
+        if (instance.raycast(camera.Position, camera.Front, hit))
+            picked = "cube instance";
+    if (picked)
+        cout << "Picked " << picked << " mesh " << hit.mesh << " triangle " << hit.triangle << " at distance " << hit.t << endl;
+    else
+        cout << "Picked nothing" << endl;
+}
+
 static void processInput(GLFWwindow *window, float time) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -98,6 +138,12 @@ static void processInput(GLFWwindow *window, float time) {
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    static bool picking = false;
+    bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    if (pressed && !picking)
+        pick();
+    picking = pressed;
 }
 
 int main() {
@@ -119,9 +165,9 @@ int main() {
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
-    glEnable(GL_MULTISAMPLE);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_MULTISAMPLE);
+    GLState::enable(GL_MULTISAMPLE);
     setup();
 
     // Draw
@@ -135,9 +181,11 @@ int main() {
     }
 
     // Terminate
+    delete reloader;
     delete program;
-    delete mitsuba;
-    delete cube;
+    cubes.clear(); // the models go with their last user, while the context is still there
+    mitsuba.reset();
+    cube.reset();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,210 @@
+// Where Model load time goes, per phase, for every model below a directory: cold, warm and from the caches.
+// Writes JSON so runs can be kept and compared across commits. Opens a hidden window for the GL context.
+// usage: model_benchmark [--objloader] [--label name] [--output file.json] [directory], run from bin/ like the demos
+//
+//   cold    .meshcache and .dds files deleted, the files dropped from the page cache where the OS allows it
+//   warm    caches deleted again, the files still in the page cache from the cold run
+//   cached  loads from the .meshcache and .dds files the warm run wrote
+//
+// The caches below the directory are deleted and rebuilt. Peak RSS is the process' peak so far, so it only grows.
+#include "utilities.h"
+#include <iomanip>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+struct ModelRun {
+    string path;
+    LoadTimings timings;
+    double total;
+    size_t meshes;
+};
+
+static bool endsWith(const string &text, const string &suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// deletes the caches of the files, never files that are not derived from another file in the list
+static void removeCaches(const vector<string> &files) {
+    for (const string &file : files)
+        for (const char *suffix : { ".meshcache", ".dds" })
+            if (endsWith(file, suffix) && std::find(files.begin(), files.end(),
+                                                    file.substr(0, file.size() - strlen(suffix))) != files.end())
+                unlink(file.c_str());
+}
+
+// drops the files from the page cache, false where there is no way to ask for it
+static bool evict(const vector<string> &files) {
+#ifdef POSIX_FADV_DONTNEED
+    for (const string &file : files) {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+static long peakRssKiB() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return long(usage.ru_maxrss / 1024); // bytes on macOS, KiB elsewhere
+#else
+    return long(usage.ru_maxrss);
+#endif
+}
+
+static string jsonString(const string &text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+static void writeTimings(ostream &out, const LoadTimings &t) {
+    out << "\"fileRead\": " << t.fileRead << ", \"parse\": " << t.parse << ", \"postProcess\": " << t.postProcess
+        << ", \"convert\": " << t.convert << ", \"textures\": " << t.textures << ", \"upload\": " << t.upload
+        << ", \"cacheRead\": " << t.cacheRead << ", \"cacheWrite\": " << t.cacheWrite << ", \"cacheHits\": " << t.cacheHits;
+}
+
+static void addTimings(LoadTimings &sum, const LoadTimings &t) {
+    sum.fileRead += t.fileRead;
+    sum.parse += t.parse;
+    sum.postProcess += t.postProcess;
+    sum.convert += t.convert;
+    sum.textures += t.textures;
+    sum.upload += t.upload;
+    sum.cacheRead += t.cacheRead;
+    sum.cacheWrite += t.cacheWrite;
+    sum.cacheHits += t.cacheHits;
+}
+
+static vector<ModelRun> loadAll(const vector<string> &models, const ModelOptions &defaults) {
+    vector<ModelRun> runs;
+    for (const string &path : models) {
+        ModelRun run;
+        run.path = path;
+        ModelOptions options = defaults;
+        options.timings = &run.timings;
+        auto start = chrono::steady_clock::now();
+        {
+            Model model(path, false, options);
+            run.meshes = model.meshes.size();
+        }
+        run.total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        runs.push_back(run);
+    }
+    return runs;
+}
+
+int main(int argc, char **argv) {
+    string directory = "resources", output = "model_benchmark.json", label;
+    ModelOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--objloader")
+            options.objLoader = true;
+        else if (arg == "--label" && i + 1 < argc)
+            label = argv[++i];
+        else if (arg == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else
+            directory = arg;
+    }
+
+    vector<string> files;
+    AssetPack::listFiles(AssetPack::normalize(directory), files);
+    sort(files.begin(), files.end());
+    vector<string> models;
+    Assimp::Importer importer;
+    for (const string &file : files) {
+        size_t dot = file.find_last_of('.');
+        if (dot != string::npos && file.find('/', dot) == string::npos && importer.IsExtensionSupported(file.substr(dot)))
+            models.push_back(file);
+    }
+    if (models.empty()) {
+        cout << "No models below " << directory << endl;
+        return 1;
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "model_benchmark", NULL, NULL);
+    if (!window) {
+        cout << "Failed to create a GL context" << endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+
+    ostringstream json;
+    json << fixed << setprecision(3);
+    json << "{\n  \"label\": " << jsonString(label) << ",\n  \"time\": " << long(time(nullptr))
+         << ",\n  \"loader\": \"" << (options.objLoader ? "ObjLoader" : "Assimp") << "\",\n  \"threads\": "
+         << workerCount() << ",\n  \"runs\": [";
+    cout << left << setw(8) << "run" << right << setw(12) << "total ms" << setw(10) << "read" << setw(10) << "parse"
+         << setw(10) << "post" << setw(10) << "convert" << setw(10) << "textures" << setw(10) << "upload"
+         << setw(10) << "cache" << setw(14) << "peak RSS KiB" << endl;
+
+    const char *modes[] = { "cold", "warm", "cached" };
+    for (int m = 0; m < 3; m++) {
+        string mode = modes[m];
+        bool evicted = false;
+        if (mode != "cached")
+            removeCaches(files);
+        if (mode == "cold")
+            evicted = evict(files);
+        vector<ModelRun> runs = loadAll(models, options);
+        if (mode != "cached") { // pick up the caches the run wrote
+            files.clear();
+            AssetPack::listFiles(AssetPack::normalize(directory), files);
+        }
+
+        LoadTimings sum;
+        double total = 0.0;
+        for (const ModelRun &run : runs) {
+            addTimings(sum, run.timings);
+            total += run.total;
+        }
+        long peak = peakRssKiB();
+        json << (m ? "," : "") << "\n    {\n      \"mode\": \"" << mode << "\", \"evicted\": " << (evicted ? "true" : "false")
+             << ", \"peakRssKiB\": " << peak << ", \"total\": " << total << ",\n      \"phases\": { ";
+        writeTimings(json, sum);
+        json << " },\n      \"models\": [";
+        for (size_t i = 0; i < runs.size(); i++) {
+            json << (i ? "," : "") << "\n        { \"path\": " << jsonString(runs[i].path) << ", \"meshes\": " << runs[i].meshes
+                 << ", \"total\": " << runs[i].total << ", ";
+            writeTimings(json, runs[i].timings);
+            json << " }";
+        }
+        json << "\n      ]\n    }";
+        cout << left << setw(8) << mode << right << fixed << setprecision(1) << setw(12) << total << setw(10) << sum.fileRead
+             << setw(10) << sum.parse << setw(10) << sum.postProcess << setw(10) << sum.convert << setw(10) << sum.textures
+             << setw(10) << sum.upload << setw(10) << sum.cacheRead << setw(14) << peak
+             << (mode == "cold" && !evicted ? "  (page cache not dropped)" : "") << endl;
+    }
+    json << "\n  ]\n}\n";
+
+    ofstream file(output);
+    file << json.str();
+    cout << models.size() << " models, timings written to " << output << endl;
+    glfwTerminate();
+    return file ? 0 : 1;
+}
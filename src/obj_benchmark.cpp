@@ -0,0 +1,65 @@
+// Load time of ObjLoader against Assimp's OBJ importer. Needs no window or GL context.
+// usage: obj_benchmark [model.obj ...], run from bin/ like the demos
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "obj_loader.h"
+
+using namespace std;
+
+static const int RUNS = 7;
+
+// median of RUNS timings in milliseconds
+template<typename Function>
+static double medianMilliseconds(Function function) {
+    vector<double> times;
+    for (int run = 0; run < RUNS; run++) {
+        auto start = chrono::high_resolution_clock::now();
+        function();
+        times.push_back(chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    return times[RUNS / 2];
+}
+
+int main(int argc, char **argv) {
+    vector<string> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+        paths = { "resources/teapot/teapot.obj", "resources/planet/planet.obj", "resources/nanosuit/nanosuit.obj" };
+
+    cout << left << setw(36) << "model" << right << setw(12) << "Assimp ms" << setw(12) << "ObjLoader ms"
+         << setw(10) << "speedup" << setw(12) << "triangles" << "   (" << workerCount() << " threads)" << endl;
+    for (const string &path : paths) {
+        size_t assimpTriangles = 0, objTriangles = 0;
+        // the same post processing Model asks for, minus aiProcess_CalcTangentSpace. ObjLoader meshes get
+        // their tangents from Model::calculateTangents instead, neither is timed.
+        double assimpTime = medianMilliseconds([&]() {
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+            assimpTriangles = 0;
+            if (!scene) return;
+            for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+                assimpTriangles += scene->mMeshes[m]->mNumFaces;
+        });
+        double objTime = medianMilliseconds([&]() {
+            ObjScene scene;
+            ObjLoader::load(path, scene);
+            objTriangles = 0;
+            for (const ObjMesh &mesh : scene.meshes)
+                objTriangles += mesh.indices.size() / 3;
+        });
+        cout << left << setw(36) << path << right << fixed << setprecision(2) << setw(12) << assimpTime
+             << setw(12) << objTime << setw(9) << assimpTime / objTime << "x" << setw(12) << objTriangles << endl;
+        if (assimpTriangles != objTriangles)
+            cout << "  WARNING: Assimp read " << assimpTriangles << " triangles" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+// Builds the asset pack the demos mount: every file below the given directories in one file, read with a
+// single mmap at startup. Run texture_compress first to include the .dds textures, and a demo once to include
+// the .meshcache files.
+// usage: pack_assets [output.pack [directory ...]], run from bin/ like the demos
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "asset_pack.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    string output = argc > 1 ? argv[1] : "assets.pack";
+    vector<string> directories;
+    for (int i = 2; i < argc; i++)
+        directories.push_back(argv[i]);
+    if (directories.empty())
+        directories = { "resources", "shaders" };
+
+    auto start = chrono::high_resolution_clock::now();
+    string error;
+    long count = AssetPack::build(directories, output, error);
+    if (count < 0) {
+        cout << "ERROR::PACK:: " << error << endl;
+        return 1;
+    }
+    double milliseconds = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+    AssetPack pack;
+    if (!pack.open(output)) {
+        cout << "ERROR::PACK:: can't read back " << output << endl;
+        return 1;
+    }
+    MappedFile file(output);
+    cout << "Packed " << count << " files into " << output << " (" << (file.length() >> 10) << " KiB) in "
+         << milliseconds << " ms" << endl;
+    return 0;
+}
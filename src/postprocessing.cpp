@@ -13,6 +13,7 @@ static void setup() {
                                 "shaders/postprocessing/postprocessing_fragment.glsl");
     mitsuba = new Model("resources/mitsuba/mitsuba.obj");
     cube = new Model("resources/cube/cube.obj");
+    cube->transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, 0.0f));
 
     const float quadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
         // positions   // texCoords
@@ -26,15 +27,15 @@ static void setup() {
     };
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    GLState::bindVertexArray(quadVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)) );
     glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::bindVertexArray(0);
 
     postprocessing->use();
     postprocessing->setInt("screenTex", 0);
@@ -42,11 +43,11 @@ static void setup() {
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
     glGenTextures(1, &texColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+    GLState::bindTexture(GL_TEXTURE_2D, texColorBuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
 
     glGenRenderbuffers(1, &rbo);
@@ -60,7 +61,7 @@ static void setup() {
 }
 
 static void draw(float time) {
-    glEnable(GL_DEPTH_TEST);
+    GLState::enable(GL_DEPTH_TEST);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -80,31 +81,23 @@ static void draw(float time) {
     program->setVec3("dirLight.diffuse", glm::vec3(0.6f, 0.3f, 0.2f));
     program->setVec3("dirLight.specular", glm::vec3(0.2f));
 
-    glm::mat4 model, view, projection; // view and projection matrices
+    glm::mat4 view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
     program->setMat4("view", view);
     program->setMat4("projection", projection);
 
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model))); // model 1: mitsuba
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    mitsuba->Draw(*program);
-
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f)); // model 2: cube
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    cube->Draw(*program);
+    mitsuba->Draw(*program, view); // sets model and normalMat from the model's transforms
+    cube->Draw(*program, view);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
-    glDisable(GL_DEPTH_TEST);
+    GLState::disable(GL_DEPTH_TEST);
 
     postprocessing->use();
-    glBindVertexArray(quadVAO);
-    glBindTexture(GL_TEXTURE_2D, texColorBuffer);
+    GLState::bindVertexArray(quadVAO);
+    GLState::bindTextureUnit(0, GL_TEXTURE_2D, texColorBuffer);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
@@ -176,7 +169,7 @@ int drawModel() {
     // Draw
     while (!glfwWindowShouldClose(window)) {
         processInput(window, glfwGetTime());
-        glEnable(GL_DEPTH_TEST);
+        GLState::enable(GL_DEPTH_TEST);
         // glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         draw(glfwGetTime());
         glfwSwapBuffers(window);
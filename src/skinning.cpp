@@ -0,0 +1,165 @@
+#include "utilities.h"
+#include <chrono>
+
+// a crowd of skinned characters animated on the CPU and drawn from one bone palette buffer.
+// usage: skinning character.dae (any skinned, animated file Assimp reads), run from bin/ like the demos
+static const GLsizei width = 1024, height = 576;
+static Camera camera(glm::vec3(0.0f, 4.0f, 30.0f));
+
+static const int CHARACTER_ROWS = 20; // CHARACTER_ROWS squared characters, each playing its own clip time
+
+static Shader *program;
+static Model *character;
+static vector<AnimationState> characters;
+static BonePaletteBuffer *palettes;
+static TextRenderer *text;
+static FrameCounter *counter;
+
+static void setup(const char *path) {
+    program = new Shader("shaders/skinning/skinning.vs.glsl", "shaders/model/model.fs.glsl");
+    BonePaletteBuffer::bindBlock(*program);
+    character = new Model(path);
+    palettes = new BonePaletteBuffer();
+    text = new TextRenderer("resources/IBMPlexMono-Regular.ttf", glm::ivec2(width, height));
+    counter = new FrameCounter(text);
+
+    for (int row = 0; row < CHARACTER_ROWS; row++)
+        for (int column = 0; column < CHARACTER_ROWS; column++) {
+            AnimationState state = character->createAnimationState(character->clips.empty() ? -1 : 0);
+            state.pose.setPosition(0, glm::vec3((column - CHARACTER_ROWS / 2) * 2.0f, 0.0f, -row * 2.0f));
+            state.pose.setScale(0, glm::vec3(0.01f)); // the usual centimeter units of skinned files
+            state.time = 0.1f * (row * CHARACTER_ROWS + column);
+            characters.push_back(std::move(state));
+        }
+}
+
+static void draw(float time) {
+    static float lastTime = time;
+    float deltaTime = time - lastTime;
+    lastTime = time;
+
+    auto start = chrono::high_resolution_clock::now();
+    Animator::update(characters, character->clips, character->bones, deltaTime);
+    double animateTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+    palettes->upload(characters);
+
+    program->use();
+    program->setFloat("material.shininess", 32.0f); // lighting
+    program->setVec3("pointLight.position", glm::vec3(1.0f, 4.0f, 1.0f));
+    program->setVec3("pointLight.ambient", glm::vec3(0.1f));
+    program->setVec3("pointLight.diffuse", glm::vec3(0.8f));
+    program->setVec3("pointLight.specular", glm::vec3(0.7f));
+    program->setFloat("pointLight.constant", 1.0f);
+    program->setFloat("pointLight.linear", 0.09f);
+    program->setFloat("pointLight.quadratic", 0.032f);
+    program->setVec3("dirLight.direction", 2.0f, -1.0f, -1.0f);
+    program->setVec3("dirLight.ambient", glm::vec3(0.05f));
+    program->setVec3("dirLight.diffuse", glm::vec3(0.4f));
+    program->setVec3("dirLight.specular", glm::vec3(0.2f));
+
+    glm::mat4 view, projection; // view and projection matrices
+    view = camera.GetViewMatrix();
+    projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 200.0f);
+    program->setMat4("view", view);
+    program->setMat4("projection", projection);
+    for (size_t i = 0; i < characters.size(); i++) {
+        palettes->bind(i);
+        character->Draw(*program, view, characters[i]);
+    }
+
+    counter->count();
+    counter->render();
+    string stats = to_string(characters.size()) + " characters, " + to_string(character->bones.size()) + " bones, animated in "
+                 + to_string(animateTime).substr(0, 5) + " ms on " + to_string(workerCount()) + " threads";
+    text->render(stats.c_str(), glm::vec2(20.0f, 40.0f), 14.0f / text->getPixelSize(), glm::vec3(1.0));
+}
+
+static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+    static float lastX = width / 2.0f, lastY = height / 2.0f;
+    static bool firstMouse = true;
+
+    if (firstMouse) {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    camera.ProcessMouseScroll(yoffset);
+}
+
+static void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+    glViewport(0, 0, width, height);
+}
+
+static void processInput(GLFWwindow *window, float time) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    static float deltaTime = 0.0f, lastFrame = 0.0f;
+    deltaTime = time - lastFrame;
+    lastFrame = time;
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: skinning character.dae" << std::endl;
+        return -1;
+    }
+    // Initialization
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_SAMPLES, 4);
+    GLFWwindow* window = glfwCreateWindow(width, height, "OpenGL program", NULL, NULL); // window hint first, then create
+    if (!window) {
+        std::cout << "Failed to create an GLFW window. " << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_MULTISAMPLE);
+    setup(argv[1]);
+
+    // Draw
+    while (!glfwWindowShouldClose(window)) {
+        processInput(window, glfwGetTime());
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        draw(glfwGetTime());
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    // Terminate
+    delete program;
+    delete character;
+    delete palettes;
+    glfwTerminate();
+    return 0;
+}
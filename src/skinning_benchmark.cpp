@@ -0,0 +1,127 @@
+// CPU skinning and animation sampling throughput on a synthetic character. Needs no window or GL context.
+// The scalar and the AVX2 skinning results are compared, build with AVX2 and FMA enabled to get the latter.
+// usage: skinning_benchmark [characters]
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include "animation.h"
+
+using namespace std;
+
+static const int BONE_COUNT = 64;
+static const int VERTEX_COUNT = 1 << 16;
+static const int KEY_COUNT = 30;       // keys per channel over a one second clip
+static const int SKIN_RUNS = 20;
+
+struct SkinnedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    uint8_t boneIds[4];
+    uint8_t boneWeights[4];
+};
+
+static double millisecondsSince(chrono::high_resolution_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// a chain of bones swinging around random axes
+static void buildSkeleton(TransformHierarchy &pose, vector<Bone> &bones, AnimationClip &clip, mt19937 &generator) {
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    pose.addNode(-1);
+    clip.duration = 1.0f;
+    for (int b = 0; b < BONE_COUNT; b++) {
+        int node = pose.addNode(b == 0 ? 0 : b, glm::vec3(0.0f, 0.1f, 0.0f));
+        bones.push_back({ "bone" + to_string(b), node, glm::mat4(1.0f) });
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) + glm::vec3(0.0f, 0.0f, 2.0f));
+        clip.channels.push_back({ node, 0, 0, unsigned(clip.rotationTimes.size()), KEY_COUNT, 0, 0 });
+        for (int k = 0; k < KEY_COUNT; k++) {
+            clip.rotationTimes.push_back(float(k) / (KEY_COUNT - 1));
+            clip.rotations.push_back(glm::angleAxis(0.3f * std::sin(6.2831853f * k / (KEY_COUNT - 1)), axis));
+        }
+    }
+    pose.update();
+    for (Bone &bone : bones)
+        bone.offset = pose.inverseWorld(bone.node);
+}
+
+static vector<SkinnedVertex> buildVertices(mt19937 &generator) {
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    uniform_int_distribution<int> bone(0, BONE_COUNT - 1), influences(1, 4);
+    vector<SkinnedVertex> vertices(VERTEX_COUNT);
+    for (SkinnedVertex &vertex : vertices) {
+        vertex.position = glm::vec3(unit(generator), unit(generator) * 3.0f + 3.0f, unit(generator));
+        vertex.normal = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) + glm::vec3(0.0f, 0.0f, 0.01f));
+        unsigned int ids[4];
+        float weights[4];
+        int count = influences(generator);
+        for (int k = 0; k < count; k++) {
+            ids[k] = bone(generator);
+            weights[k] = unit(generator) + 1.5f;
+        }
+        Animator::packWeights(ids, weights, count, vertex.boneIds, vertex.boneWeights);
+    }
+    return vertices;
+}
+
+int main(int argc, char **argv) {
+    int characterCount = argc > 1 ? atoi(argv[1]) : 500;
+    mt19937 generator(7);
+    TransformHierarchy bindPose;
+    vector<Bone> bones;
+    vector<AnimationClip> clips(1);
+    buildSkeleton(bindPose, bones, clips[0], generator);
+
+    vector<AnimationState> states(characterCount);
+    for (int i = 0; i < characterCount; i++) {
+        states[i].pose = bindPose;
+        states[i].clip = 0;
+        states[i].time = 0.37f * i;
+    }
+    Animator::update(states, clips, bones, 0.0f); // warm up the worker threads
+    auto start = chrono::high_resolution_clock::now();
+    const int frames = 60;
+    for (int frame = 0; frame < frames; frame++)
+        Animator::update(states, clips, bones, 1.0f / 60.0f);
+    double animateTime = millisecondsSince(start) / frames;
+    cout << characterCount << " characters, " << BONE_COUNT << " bones: sampled, posed and palettes built in "
+         << fixed << setprecision(3) << animateTime << " ms per frame on " << workerCount() << " threads" << endl;
+
+    vector<SkinnedVertex> vertices = buildVertices(generator);
+    const glm::mat4 *palette = states.back().palette.data();
+    vector<glm::vec3> scalarPositions(VERTEX_COUNT), scalarNormals(VERTEX_COUNT), positions(VERTEX_COUNT), normals(VERTEX_COUNT);
+
+    start = chrono::high_resolution_clock::now();
+    for (int run = 0; run < SKIN_RUNS; run++)
+        Animator::skinScalar(vertices.data(), VERTEX_COUNT, sizeof(SkinnedVertex), offsetof(SkinnedVertex, normal),
+                             offsetof(SkinnedVertex, boneIds), palette, scalarPositions.data(), scalarNormals.data());
+    double scalarTime = millisecondsSince(start) / SKIN_RUNS;
+    cout << "  " << left << setw(16) << "scalar skinning" << right << setw(10) << VERTEX_COUNT / scalarTime * 1e-3
+         << " Mvertices/s" << endl;
+
+#ifdef SKINNING_AVX2
+    start = chrono::high_resolution_clock::now();
+    for (int run = 0; run < SKIN_RUNS; run++)
+        Animator::skinAvx2(vertices.data(), VERTEX_COUNT, sizeof(SkinnedVertex), offsetof(SkinnedVertex, normal),
+                           offsetof(SkinnedVertex, boneIds), palette, positions.data(), normals.data());
+    double avx2Time = millisecondsSince(start) / SKIN_RUNS;
+    cout << "  " << left << setw(16) << "AVX2 skinning" << right << setw(10) << VERTEX_COUNT / avx2Time * 1e-3
+         << " Mvertices/s  (" << setprecision(2) << scalarTime / avx2Time << "x)" << endl;
+
+    float positionError = 0.0f, normalError = 0.0f;
+    for (int v = 0; v < VERTEX_COUNT; v++) {
+        positionError = std::max(positionError, glm::length(positions[v] - scalarPositions[v]));
+        normalError = std::max(normalError, glm::length(normals[v] - scalarNormals[v]));
+    }
+    cout << "  largest difference to scalar: position " << scientific << positionError << ", normal " << normalError << endl;
+    if (positionError > 1e-4f || normalError > 1e-4f)
+        cout << "  WARNING: AVX2 skinning disagrees with the scalar path" << endl;
+#else
+    cout << "  AVX2 skinning not compiled in, build with -mavx2 -mfma" << endl;
+#endif
+    return 0;
+}
@@ -11,12 +11,13 @@ static void setup() {
     outline = new Shader("shaders/outline/outline_vertex.glsl", "shaders/outline/outline_fragment.glsl");
     mitsuba = new Model("resources/mitsuba/mitsuba.obj");
     cube = new Model("resources/cube/cube.obj");
-    glEnable(GL_STENCIL_TEST);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    cube->transforms.setPosition(0, glm::vec3(-3.0f, 0.45f, 0.0f));
+    GLState::enable(GL_STENCIL_TEST);
+    GLState::stencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 }
 
 static void draw(float time) {
-    glStencilMask(0x00);
+    GLState::stencilMask(0x00);
     program->use();
 
     glm::vec3 pointLightPos(1.0f, 2.0f, 1.0f);
@@ -33,36 +34,29 @@ static void draw(float time) {
     program->setVec3("dirLight.diffuse", glm::vec3(0.4f));
     program->setVec3("dirLight.specular", glm::vec3(0.2f));
 
-    glm::mat4 model, view, projection; // view and projection matrices
+    glm::mat4 view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
     program->setMat4("view", view);
     program->setMat4("projection", projection);
 
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model))); // model 1: mitsuba
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    mitsuba->Draw(*program);
-
-    glStencilFunc(GL_ALWAYS, 1, 0xFF);
-    glStencilMask(0xFF);
-    model = glm::translate(model, glm::vec3(-3.0f, 0.45f, 0.0f)); // model 2: cube
-    normalMat = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat3("normalMat", normalMat);
-    cube->Draw(*program);
-
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-    glStencilMask(0x00);
-    glDisable(GL_DEPTH_TEST);
+    mitsuba->Draw(*program, view); // sets model and normalMat from the model's transforms
+
+    GLState::stencilFunc(GL_ALWAYS, 1, 0xFF);
+    GLState::stencilMask(0xFF);
+    cube->Draw(*program, view);
+
+    GLState::stencilFunc(GL_NOTEQUAL, 1, 0xFF);
+    GLState::stencilMask(0x00);
+    GLState::disable(GL_DEPTH_TEST);
     outline->use();
-    model = glm::scale(model, glm::vec3(1.05f));
-    outline->setMat4("model", model);
     outline->setMat4("view", view);
     outline->setMat4("projection", projection);
+    cube->transforms.setScale(0, glm::vec3(1.05f));
     cube->Draw(*outline);
-    glStencilMask(0xFF);
-    glEnable(GL_DEPTH_TEST);
+    cube->transforms.setScale(0, glm::vec3(1.0f));
+    GLState::stencilMask(0xFF);
+    GLState::enable(GL_DEPTH_TEST);
 }
 
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -133,7 +127,7 @@ int drawModel() {
     // Draw
     while (!glfwWindowShouldClose(window)) {
         processInput(window, glfwGetTime());
-        glEnable(GL_DEPTH_TEST);
+        GLState::enable(GL_DEPTH_TEST);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         draw(glfwGetTime());
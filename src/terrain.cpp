@@ -21,9 +21,9 @@ public:
 
     void draw(Shader program) {
         program.use();
-        glBindVertexArray(VAO);
+        GLState::bindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, _indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        GLState::bindVertexArray(0);
     }
 
     ~Terrain() {
@@ -214,17 +214,17 @@ private:
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::bindVertexArray(VAO);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, _num * _num * sizeof(Vertex), _vertices, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * _indices.size(), &_indices[0], GL_STATIC_DRAW);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
         glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::bindVertexArray(0);
     }
 
 };
@@ -247,28 +247,27 @@ static void setup() {
 static void draw(float time) {
     program->use();
     glm::vec3 pointLightPos(3.0f, 4.0f, 3.0f);
-    program->setFloat("material.shininess", 32.0f); // lighting
-    program->setVec3("pointLight.position", pointLightPos);
-    program->setVec3("pointLight.ambient", glm::vec3(0.1f));
-    program->setVec3("pointLight.diffuse", glm::vec3(0.8f));
-    program->setVec3("pointLight.specular", glm::vec3(0.7f));
-    program->setFloat("pointLight.constant", 1.0f);
-    program->setFloat("pointLight.linear", 0.09f);
-    program->setFloat("pointLight.quadratic", 0.032f);
-    program->setVec3("dirLight.direction", 2.0f, -1.0f, -1.0f);
-    program->setVec3("dirLight.ambient", glm::vec3(0.05f));
-    program->setVec3("dirLight.diffuse", glm::vec3(0.4f));
-    program->setVec3("dirLight.specular", glm::vec3(0.2f));
-    program->setBool("useBlinn", true);
+    program->setFloat("material.shininess"_u, 32.0f); // lighting
+    program->setVec3("pointLight.position"_u, pointLightPos);
+    program->setVec3("pointLight.ambient"_u, glm::vec3(0.1f));
+    program->setVec3("pointLight.diffuse"_u, glm::vec3(0.8f));
+    program->setVec3("pointLight.specular"_u, glm::vec3(0.7f));
+    program->setFloat("pointLight.constant"_u, 1.0f);
+    program->setFloat("pointLight.linear"_u, 0.09f);
+    program->setFloat("pointLight.quadratic"_u, 0.032f);
+    program->setVec3("dirLight.direction"_u, 2.0f, -1.0f, -1.0f);
+    program->setVec3("dirLight.ambient"_u, glm::vec3(0.05f));
+    program->setVec3("dirLight.diffuse"_u, glm::vec3(0.4f));
+    program->setVec3("dirLight.specular"_u, glm::vec3(0.2f));
 
     glm::mat4 model, view, projection; // view and projection matrices
     view = camera.GetViewMatrix();
     projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
-    glm::mat3 normalMat(glm::transpose(glm::inverse(view * model)));
-    program->setMat4("model", model);
-    program->setMat4("view", view);
-    program->setMat4("projection", projection);
-    program->setMat3("normalMat", normalMat);
+    glm::mat3 normalMat(view); // the terrain is not transformed and the view is rigid
+    program->setMat4("model"_u, model);
+    program->setMat4("view"_u, view);
+    program->setMat4("projection"_u, projection);
+    program->setMat3("normalMat"_u, normalMat);
     land->draw(*program);
 
     counter->count();
@@ -339,8 +338,8 @@ int main() {
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
+    GLState::enable(GL_DEPTH_TEST);
+    GLState::enable(GL_MULTISAMPLE);
     setup();
 
     // Draw
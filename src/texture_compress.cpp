@@ -0,0 +1,62 @@
+// Offline texture compression. Writes <image>.dds next to each image, the cache textureFromFile reads,
+// and reports the encode time and the size against the uncompressed texture. Needs no window or GL context.
+// usage: texture_compress image ..., run from bin/ like the demos
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "texture_compressor.h"
+
+using namespace std;
+
+static const char *formatName(BlockFormat format) {
+    const char *names[] = { "BC1", "BC3", "BC4", "BC5" };
+    return names[format];
+}
+
+int main(int argc, char **argv) {
+    vector<string> paths;
+    for (int i = 1; i < argc; i++)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+        paths = { "resources/container2.jpg", "resources/container2_specular.jpg", "resources/nanosuit/body_dif.png" };
+
+    cout << left << setw(40) << "image" << right << setw(12) << "size" << setw(8) << "format" << setw(8) << "levels"
+         << setw(12) << "encode ms" << setw(12) << "raw KiB" << setw(12) << "BC KiB" << setw(8) << "ratio"
+         << "   (" << workerCount() << " threads)" << endl;
+    int failed = 0;
+    for (const string &path : paths) {
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (!data) {
+            cout << "ERROR::TEXTURE:: failed to load " << path << endl;
+            failed++;
+            continue;
+        }
+        BlockFormat format = TextureCompressor::formatFor(channels);
+        auto start = chrono::high_resolution_clock::now();
+        CompressedImage image = TextureCompressor::compress(data, width, height, channels, format);
+        double milliseconds = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+        stbi_image_free(data);
+        if (!TextureCompressor::saveDds(path + ".dds", image)) {
+            cout << "ERROR::TEXTURE:: failed to write " << path << ".dds" << endl;
+            failed++;
+            continue;
+        }
+
+        // against the same mip chain uploaded uncompressed with the image's channels
+        double raw = 0.0, compressed = 0.0;
+        for (const CompressedLevel &level : image.levels) {
+            raw += double(level.width) * level.height * channels;
+            compressed += level.data.size();
+        }
+        cout << left << setw(40) << path << right << setw(12) << (to_string(width) + "x" + to_string(height))
+             << setw(8) << formatName(format) << setw(8) << image.levels.size() << fixed << setprecision(2)
+             << setw(12) << milliseconds << setprecision(0) << setw(12) << raw / 1024.0 << setw(12) << compressed / 1024.0
+             << setprecision(1) << setw(7) << raw / compressed << "x" << endl;
+    }
+    return failed ? 1 : 0;
+}
@@ -21,22 +21,22 @@ static void setup() {
     }
 
     glGenBuffers(1, &uboMatrices);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
     glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4)); // bind ubo to binding points: uboMatrices -> 0
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4)); // bind ubo to binding points: uboMatrices -> 0
 
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), float(width) / height, 0.1f, 100.0f);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &projection[0][0]);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 static void draw(float time) {
     glm::mat4 view = camera.GetViewMatrix();
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
     glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &view[0][0]);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
 
     const vector<glm::vec3> positions {
         glm::vec3(-0.75, 0.75, 0),
@@ -46,9 +46,8 @@ static void draw(float time) {
     };
     for (int i = 0; i < 4; i++) {
         ubo[i]->use();
-        glm::mat4 model = glm::translate(glm::mat4(), positions[i]);
-        ubo[i]->setMat4("model", model);
-        cube->Draw(*ubo[i]);
+        cube->transforms.setPosition(0, positions[i]);
+        cube->Draw(*ubo[i]); // sets model from the model's transforms
     }
 }
 
@@ -113,7 +112,7 @@ int main() {
     // Draw
     while (!glfwWindowShouldClose(window)) {
         processInput(window, glfwGetTime());
-        glEnable(GL_DEPTH_TEST);
+        GLState::enable(GL_DEPTH_TEST);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         draw(glfwGetTime());